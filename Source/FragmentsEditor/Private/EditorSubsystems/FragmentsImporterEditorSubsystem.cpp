@@ -14,6 +14,32 @@ FString UFragmentsImporterEditorSubsystem::LoadFragment(const FString& FragPath)
     return ModelGuid;
 }
 
+int32 UFragmentsImporterEditorSubsystem::LoadFragmentAsync(const FString& FragPath, FOnFragmentLoadProgress OnProgress, FOnFragmentLoadCompleted OnCompleted)
+{
+    check(Importer);
+
+    TWeakObjectPtr<UFragmentsImporterEditorSubsystem> WeakThis(this);
+    return Importer->LoadFragmentAsync(FragPath,
+        [OnProgress](int32 RequestId, float Progress)
+        {
+            OnProgress.ExecuteIfBound(RequestId, Progress);
+        },
+        [WeakThis, OnCompleted](int32 RequestId, const FString& ModelGuid)
+        {
+            if (WeakThis.IsValid() && WeakThis->Importer)
+            {
+                WeakThis->FragmentModels = WeakThis->Importer->GetFragmentModels();
+            }
+            OnCompleted.ExecuteIfBound(RequestId, !ModelGuid.IsEmpty(), ModelGuid);
+        });
+}
+
+void UFragmentsImporterEditorSubsystem::CancelLoadFragment(int32 RequestId)
+{
+    if (Importer)
+        Importer->CancelLoadFragment(RequestId);
+}
+
 void UFragmentsImporterEditorSubsystem::UnloadFragment(const FString& ModelGuid)
 {
     if (Importer)
@@ -26,29 +52,78 @@ void UFragmentsImporterEditorSubsystem::UnloadFragment(const FString& ModelGuid)
     }
 }
 
-FString UFragmentsImporterEditorSubsystem::ProcessFragment(AActor* OwnerActor, const FString& FragPath, TArray<class AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh)
+FString UFragmentsImporterEditorSubsystem::ProcessFragment(AActor* OwnerActor, const FString& FragPath, TArray<class AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, EFragmentMeshBuildPreset BuildPreset)
 {
     check(Importer);
 
-    FString ModelGuid = Importer->Process(OwnerActor, FragPath, OutFragments, bSaveMeshes, bUseDynamicMesh);
+    FString ModelGuid = Importer->Process(OwnerActor, FragPath, OutFragments, bSaveMeshes, bUseDynamicMesh, SpawnMode, BuildPreset);
 
     FragmentModels = Importer->GetFragmentModels();
 
     return ModelGuid;
 }
 
-void UFragmentsImporterEditorSubsystem::ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh)
+void UFragmentsImporterEditorSubsystem::ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode)
 {
     check(Importer);
 
-    Importer->ProcessLoadedFragment(InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh);
+    Importer->ProcessLoadedFragment(InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh, SpawnMode);
 }
 
-void UFragmentsImporterEditorSubsystem::ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh)
+void UFragmentsImporterEditorSubsystem::ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode)
 {
     check(Importer);
 
-    return Importer->ProcessLoadedFragmentItem(InLocalId, InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh);
+    return Importer->ProcessLoadedFragmentItem(InLocalId, InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh, SpawnMode);
+}
+
+int32 UFragmentsImporterEditorSubsystem::ProcessLoadedFragmentAsync(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, FOnFragmentSpawnProgress OnProgress, FOnFragmentSpawnCompleted OnCompleted)
+{
+    check(Importer);
+
+    return Importer->ProcessLoadedFragmentAsync(InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh, SpawnMode,
+        [OnProgress](int32 TaskId, float Progress)
+        {
+            OnProgress.ExecuteIfBound(TaskId, Progress);
+        },
+        [OnCompleted](int32 TaskId, AFragment* RootFragment)
+        {
+            OnCompleted.ExecuteIfBound(TaskId, RootFragment != nullptr, RootFragment);
+        });
+}
+
+void UFragmentsImporterEditorSubsystem::CancelProcessLoadedFragment(int32 TaskId)
+{
+    if (Importer)
+        Importer->CancelProcessLoadedFragment(TaskId);
+}
+
+void UFragmentsImporterEditorSubsystem::SetSpawnBudgetMs(float InBudgetMs)
+{
+    check(Importer);
+
+    Importer->SetSpawnBudgetMs(InBudgetMs);
+}
+
+void UFragmentsImporterEditorSubsystem::SetGeometryCacheDirectory(const FString& InDirectory)
+{
+    check(Importer);
+
+    Importer->SetGeometryCacheDirectory(InDirectory);
+}
+
+void UFragmentsImporterEditorSubsystem::SetUseGeometryCache(bool bInUseGeometryCache)
+{
+    check(Importer);
+
+    Importer->SetUseGeometryCache(bInUseGeometryCache);
+}
+
+void UFragmentsImporterEditorSubsystem::SetMeshBuildSettings(const FFragmentMeshBuildSettings& InSettings)
+{
+    check(Importer);
+
+    Importer->SetMeshBuildSettings(InSettings);
 }
 
 TArray<int32> UFragmentsImporterEditorSubsystem::GetElementsByCategory(const FString& InCategory, const FString& ModelGuid)
@@ -58,6 +133,62 @@ TArray<int32> UFragmentsImporterEditorSubsystem::GetElementsByCategory(const FSt
     return Importer->GetElementsByCategory(InCategory, ModelGuid);
 }
 
+TArray<int32> UFragmentsImporterEditorSubsystem::GetElementsByCategories(const TArray<FString>& InCategories, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsByCategories(InCategories, ModelGuid);
+}
+
+TArray<FFragmentCategoryElements> UFragmentsImporterEditorSubsystem::GetElementsByCategoriesGrouped(const TArray<FString>& InCategories, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsByCategoriesGrouped(InCategories, ModelGuid);
+}
+
+TArray<FString> UFragmentsImporterEditorSubsystem::GetCategories(const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetCategories(ModelGuid);
+}
+
+TArray<int32> UFragmentsImporterEditorSubsystem::GetElementsInBox(const FBox& Box, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsInBox(Box, ModelGuid);
+}
+
+TArray<int32> UFragmentsImporterEditorSubsystem::GetElementsInSphere(const FVector& Center, float Radius, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsInSphere(Center, Radius, ModelGuid);
+}
+
+TArray<int32> UFragmentsImporterEditorSubsystem::GetElementsInFrustum(const FMinimalViewInfo& View, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsInFrustum(View, ModelGuid);
+}
+
+int32 UFragmentsImporterEditorSubsystem::GetNearestElement(const FVector& Point, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetNearestElement(Point, ModelGuid);
+}
+
+bool UFragmentsImporterEditorSubsystem::RaycastFragments(const FVector& Origin, const FVector& Direction, FFragmentRaycastHit& OutHit, float MaxDistance)
+{
+    check(Importer);
+
+    return Importer->RaycastFragments(Origin, Direction, MaxDistance, OutHit);
+}
+
 AFragment* UFragmentsImporterEditorSubsystem::GetItemByLocalId(int32 InLocalId, const FString& InModelGuid)
 {
     check(Importer)
@@ -83,6 +214,12 @@ TArray<FItemAttribute> UFragmentsImporterEditorSubsystem::GetItemPropertySets(in
     return Importer->GetItemPropertySets(LocalId, InModelGuid);
 }
 
+TArray<int32> UFragmentsImporterEditorSubsystem::GetRelatedItems(int32 LocalId, const FString& InModelGuid, const FString& RelationName)
+{
+    check(Importer);
+    return Importer->GetRelatedItems(LocalId, InModelGuid, RelationName);
+}
+
 AFragment* UFragmentsImporterEditorSubsystem::GetModelFragment(const FString& InModelGuid)
 {
     check(Importer);
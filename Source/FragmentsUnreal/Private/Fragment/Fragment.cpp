@@ -8,8 +8,8 @@
 // Sets default values
 AFragment::AFragment()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Fragments don't tick, large models spawn one actor per item
+	PrimaryActorTick.bCanEverTick = false;
 
 }
 
@@ -35,7 +35,7 @@ TArray<struct FItemAttribute> AFragment::GetAttributes()
 		{
 			FFragmentItem* InItem = Sub->GetFragmentItemByLocalId(LocalId, ModelGuid);
 
-			if (!InItem->ModelGuid.IsEmpty())
+			if (InItem && !InItem->ModelGuid.IsEmpty())
 			{
 				Sub->GetItemData(InItem);
 				return InItem->Attributes;
@@ -59,9 +59,8 @@ AFragment* AFragment::FindFragmentByLocalId(int32 InLocalId)
 	return FoundFragment;
 }
 
-void AFragment::SetData(FFragmentItem InFragmentItem)
+void AFragment::SetData(const FFragmentItem& InFragmentItem)
 {
-	Data = InFragmentItem;
 	ModelGuid = InFragmentItem.ModelGuid;
 	Guid = InFragmentItem.Guid;
 	GlobalTransform = InFragmentItem.GlobalTransform;
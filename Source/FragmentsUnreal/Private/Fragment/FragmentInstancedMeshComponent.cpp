@@ -0,0 +1,60 @@
+
+
+#include "Fragment/FragmentInstancedMeshComponent.h"
+
+UFragmentInstancedMeshComponent::UFragmentInstancedMeshComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetMobility(EComponentMobility::Movable);
+}
+
+void UFragmentInstancedMeshComponent::QueueFragmentInstance(const FTransform& InstanceTransform, int32 InLocalId, const FLinearColor& InColor)
+{
+	PendingTransforms.Add(InstanceTransform);
+	PendingLocalIds.Add(InLocalId);
+	PendingColors.Add(InColor);
+}
+
+void UFragmentInstancedMeshComponent::EnableInstanceColors()
+{
+	if (NumCustomDataFloats < 4)
+	{
+		SetNumCustomDataFloats(4);
+	}
+}
+
+void UFragmentInstancedMeshComponent::FlushFragmentInstances()
+{
+	if (PendingTransforms.Num() == 0) return;
+
+	const TArray<int32> InstanceIndices = AddInstances(PendingTransforms, true, false);
+	for (int32 i = 0; i < InstanceIndices.Num(); i++)
+	{
+		const int32 InstanceIndex = InstanceIndices[i];
+		if (InstanceLocalIds.Num() <= InstanceIndex)
+		{
+			InstanceLocalIds.SetNum(InstanceIndex + 1);
+		}
+		InstanceLocalIds[InstanceIndex] = PendingLocalIds[i];
+
+		if (NumCustomDataFloats >= 4)
+		{
+			const FLinearColor& Color = PendingColors[i];
+			SetCustomData(InstanceIndex, TArrayView<const float>(&Color.R, 4), false);
+		}
+	}
+
+	if (NumCustomDataFloats >= 4)
+	{
+		MarkRenderStateDirty();
+	}
+
+	PendingTransforms.Reset();
+	PendingLocalIds.Reset();
+	PendingColors.Reset();
+}
+
+int32 UFragmentInstancedMeshComponent::GetInstanceLocalId(int32 InstanceIndex) const
+{
+	return InstanceLocalIds.IsValidIndex(InstanceIndex) ? InstanceLocalIds[InstanceIndex] : INDEX_NONE;
+}
@@ -0,0 +1,207 @@
+
+
+#include "Importer/FragmentAttributeTable.h"
+
+namespace
+{
+	struct FRawAttributeToken
+	{
+		TArray<ANSICHAR, TInlineAllocator<128>> Chars;
+		bool bQuoted = false;
+
+		FString ToString() const
+		{
+			FUTF8ToTCHAR Converted(Chars.GetData(), Chars.Num());
+			return FString(Converted.Length(), Converted.Get());
+		}
+	};
+
+	// Splits a raw ["Key","Value",TypeHash] attribute. Brackets and quotes are dropped like before,
+	// but commas inside quotes now stay part of the value.
+	void TokenizeRawAttribute(const ANSICHAR* Raw, int32 RawLength, TArray<FRawAttributeToken, TInlineAllocator<4>>& OutTokens)
+	{
+		FRawAttributeToken Current;
+		bool bInQuotes = false;
+
+		auto Flush = [&OutTokens, &Current]()
+			{
+				if (!Current.bQuoted)
+				{
+					while (Current.Chars.Num() > 0 && FCharAnsi::IsWhitespace(Current.Chars.Last())) Current.Chars.Pop(EAllowShrinking::No);
+				}
+				if (Current.Chars.Num() > 0 || Current.bQuoted)
+				{
+					OutTokens.Add(MoveTemp(Current));
+				}
+				Current = FRawAttributeToken();
+			};
+
+		for (int32 i = 0; i < RawLength; i++)
+		{
+			const ANSICHAR C = Raw[i];
+			if (C == '"')
+			{
+				bInQuotes = !bInQuotes;
+				Current.bQuoted = true;
+				continue;
+			}
+			if (!bInQuotes)
+			{
+				if (C == '[' || C == ']') continue;
+				if (C == ',') { Flush(); continue; }
+				if (FCharAnsi::IsWhitespace(C) && (Current.Chars.Num() == 0 || Current.bQuoted)) continue;
+			}
+			Current.Chars.Add(C);
+		}
+		Flush();
+	}
+}
+
+void FFragmentAttributeTable::Reset()
+{
+	ItemRowOffsets.Reset();
+	KeyIds.Reset();
+	ValueIds.Reset();
+	Types.Reset();
+	Numbers.Reset();
+	TypeHashes.Reset();
+	Strings.Reset();
+	StringIds.Reset();
+	NameKeys.Reset();
+	ValueKeys.Reset();
+}
+
+void FFragmentAttributeTable::Build(const Model* InModel)
+{
+	Reset();
+	if (!InModel || !InModel->attributes()) return;
+
+	const auto* attributes = InModel->attributes();
+	ItemRowOffsets.Reserve(attributes->size() + 1);
+
+	for (flatbuffers::uoffset_t i = 0; i < attributes->size(); i++)
+	{
+		ItemRowOffsets.Add(KeyIds.Num());
+
+		const Attribute* Attr = attributes->Get(i);
+		if (!Attr || !Attr->data()) continue;
+
+		for (flatbuffers::uoffset_t j = 0; j < Attr->data()->size(); j++)
+		{
+			const auto* Raw = Attr->data()->Get(j);
+			if (Raw) AddRow(Raw->c_str(), Raw->size());
+		}
+	}
+	ItemRowOffsets.Add(KeyIds.Num());
+
+	NameKeys.Init(false, Strings.Num());
+	ValueKeys.Init(false, Strings.Num());
+	for (int32 StringId = 0; StringId < Strings.Num(); StringId++)
+	{
+		NameKeys[StringId] = Strings[StringId].Equals(TEXT("Name"), ESearchCase::IgnoreCase);
+		ValueKeys[StringId] = UFragmentsUtils::IsValueKey(Strings[StringId]);
+	}
+}
+
+void FFragmentAttributeTable::AddRow(const ANSICHAR* Raw, int32 RawLength)
+{
+	TArray<FRawAttributeToken, TInlineAllocator<4>> Tokens;
+	TokenizeRawAttribute(Raw, RawLength, Tokens);
+	if (Tokens.Num() < 3) return;
+
+	FString Value = Tokens[1].ToString();
+	EFragmentAttributeType Type = EFragmentAttributeType::String;
+	double Number = 0.0;
+	if (!Tokens[1].bQuoted)
+	{
+		if (Value.Equals(TEXT("true"), ESearchCase::IgnoreCase) || Value.Equals(TEXT("false"), ESearchCase::IgnoreCase))
+		{
+			Type = EFragmentAttributeType::Bool;
+			Number = Value.Equals(TEXT("true"), ESearchCase::IgnoreCase) ? 1.0 : 0.0;
+		}
+		else if (!Value.IsEmpty() && FCString::IsNumeric(*Value))
+		{
+			Type = EFragmentAttributeType::Number;
+			Number = FCString::Atod(*Value);
+		}
+	}
+
+	Tokens[2].Chars.Add('\0');
+
+	KeyIds.Add(Intern(Tokens[0].ToString()));
+	ValueIds.Add(Intern(MoveTemp(Value)));
+	Types.Add(Type);
+	Numbers.Add(Number);
+	TypeHashes.Add(FCStringAnsi::Atoi64(Tokens[2].Chars.GetData()));
+}
+
+int32 FFragmentAttributeTable::Intern(FString&& InString)
+{
+	if (const int32* Found = StringIds.Find(InString))
+	{
+		return *Found;
+	}
+	const int32 StringId = Strings.Num();
+	StringIds.Add(InString, StringId);
+	Strings.Add(MoveTemp(InString));
+	return StringId;
+}
+
+int32 FFragmentAttributeTable::FindString(const FString& InString) const
+{
+	const int32* Found = StringIds.Find(InString);
+	return Found ? *Found : INDEX_NONE;
+}
+
+void FFragmentAttributeTable::GetItemAttributes(int32 ItemIndex, TArray<FItemAttribute>& OutAttributes) const
+{
+	const int32 FirstRow = GetFirstRow(ItemIndex);
+	const int32 NumItemRows = GetNumRows(ItemIndex);
+
+	OutAttributes.Reset(NumItemRows);
+	for (int32 Row = FirstRow; Row < FirstRow + NumItemRows; Row++)
+	{
+		OutAttributes.Add(FItemAttribute(GetKey(Row), GetValue(Row), TEXT(""), GetTypeHash(Row)));
+	}
+}
+
+void FFragmentAttributeTable::ResolvePropertySets(TConstArrayView<int32> Rows, TArray<FFragmentPropertyRef>& OutProperties) const
+{
+	int32 CurrentPropertySet = INDEX_NONE;
+
+	for (int32 i = 0; i + 1 < Rows.Num(); ++i)
+	{
+		const int32 Row = Rows[i];
+		const int32 NextRow = Rows[i + 1];
+		if (!NameKeys[KeyIds[Row]]) continue;
+
+		// A name followed by another name opens a property set
+		if (NameKeys[KeyIds[NextRow]])
+		{
+			CurrentPropertySet = ValueIds[Row];
+			continue;
+		}
+		if (ValueKeys[KeyIds[NextRow]])
+		{
+			OutProperties.Add({ CurrentPropertySet, Row, NextRow });
+			++i;
+		}
+	}
+}
+
+TArray<FItemAttribute> FFragmentAttributeTable::GetPropertySets(TConstArrayView<int32> Rows) const
+{
+	TArray<FFragmentPropertyRef> Properties;
+	ResolvePropertySets(Rows, Properties);
+
+	TArray<FItemAttribute> ParsedPropertySets;
+	ParsedPropertySets.Reserve(Properties.Num());
+	for (const FFragmentPropertyRef& Property : Properties)
+	{
+		FItemAttribute& pa = ParsedPropertySets.AddDefaulted_GetRef();
+		pa.Key = GetValue(Property.NameRow);
+		pa.Value = GetValue(Property.ValueRow);
+		if (Property.PropertySetId != INDEX_NONE) pa.PropertySet = Strings[Property.PropertySetId];
+	}
+	return ParsedPropertySets;
+}
@@ -0,0 +1,332 @@
+#include "Importer/FragmentBVH.h"
+#include "Algo/Partition.h"
+
+namespace
+{
+	constexpr int32 MaxLeafPrimitives = 4;
+	constexpr int32 NumSplitBins = 12;
+
+	double HalfArea(const FBox& Box)
+	{
+		if (!Box.IsValid) return 0.0;
+		const FVector Size = Box.GetSize();
+		return Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X;
+	}
+
+	// Slab test, OutEntry is where the ray enters the box, 0 if it starts inside
+	bool IntersectRayBox(const FBox& Box, const FVector& Origin, const FVector& InvDirection, double MaxDistance, double& OutEntry)
+	{
+		double Entry = 0.0;
+		double Exit = MaxDistance;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const double T0 = (Box.Min[Axis] - Origin[Axis]) * InvDirection[Axis];
+			const double T1 = (Box.Max[Axis] - Origin[Axis]) * InvDirection[Axis];
+			Entry = FMath::Max(Entry, FMath::Min(T0, T1));
+			Exit = FMath::Min(Exit, FMath::Max(T0, T1));
+		}
+		OutEntry = Entry;
+		return Entry <= Exit;
+	}
+}
+
+void FFragmentBVH::Reset()
+{
+	Nodes.Reset();
+	Boxes.Reset();
+	PrimitiveOrder.Reset();
+}
+
+void FFragmentBVH::Build(TArray<FBox>&& InBoxes)
+{
+	Reset();
+	Boxes = MoveTemp(InBoxes);
+
+	TArray<FVector> Centers;
+	Centers.SetNumUninitialized(Boxes.Num());
+	PrimitiveOrder.Reserve(Boxes.Num());
+	for (int32 Primitive = 0; Primitive < Boxes.Num(); Primitive++)
+	{
+		Centers[Primitive] = Boxes[Primitive].GetCenter();
+		if (Boxes[Primitive].IsValid)
+		{
+			PrimitiveOrder.Add(Primitive);
+		}
+	}
+	if (PrimitiveOrder.Num() == 0) return;
+
+	Nodes.Reserve(2 * FMath::DivideAndRoundUp(PrimitiveOrder.Num(), MaxLeafPrimitives));
+	BuildNode(0, PrimitiveOrder.Num(), Centers);
+}
+
+int32 FFragmentBVH::BuildNode(int32 First, int32 Count, const TArray<FVector>& Centers)
+{
+	const int32 NodeIndex = Nodes.AddDefaulted();
+
+	FBox Bounds(ForceInit);
+	FBox CenterBounds(ForceInit);
+	for (int32 Slot = First; Slot < First + Count; Slot++)
+	{
+		Bounds += Boxes[PrimitiveOrder[Slot]];
+		CenterBounds += Centers[PrimitiveOrder[Slot]];
+	}
+	Nodes[NodeIndex].Bounds = Bounds;
+
+	const FVector CenterSize = CenterBounds.GetSize();
+	const int32 Axis = CenterSize.X >= CenterSize.Y && CenterSize.X >= CenterSize.Z ? 0 : (CenterSize.Y >= CenterSize.Z ? 1 : 2);
+	if (Count <= MaxLeafPrimitives || CenterSize[Axis] <= UE_KINDA_SMALL_NUMBER)
+	{
+		Nodes[NodeIndex].Index = First;
+		Nodes[NodeIndex].NumPrimitives = Count;
+		return NodeIndex;
+	}
+
+	// Bin the centers along the widest axis and keep the split with the lowest area cost
+	const double AxisMin = CenterBounds.Min[Axis];
+	const double BinScale = NumSplitBins / CenterSize[Axis];
+	auto GetBin = [&](int32 Primitive)
+	{
+		return FMath::Clamp((int32)((Centers[Primitive][Axis] - AxisMin) * BinScale), 0, NumSplitBins - 1);
+	};
+
+	FBox BinBounds[NumSplitBins];
+	int32 BinCounts[NumSplitBins] = {};
+	for (int32 Bin = 0; Bin < NumSplitBins; Bin++)
+	{
+		BinBounds[Bin].Init();
+	}
+	for (int32 Slot = First; Slot < First + Count; Slot++)
+	{
+		const int32 Bin = GetBin(PrimitiveOrder[Slot]);
+		BinBounds[Bin] += Boxes[PrimitiveOrder[Slot]];
+		BinCounts[Bin]++;
+	}
+
+	// Cost of putting bins [0, Split] on the left
+	double LeftCosts[NumSplitBins - 1];
+	FBox Accumulated(ForceInit);
+	int32 AccumulatedCount = 0;
+	for (int32 Split = 0; Split < NumSplitBins - 1; Split++)
+	{
+		Accumulated += BinBounds[Split];
+		AccumulatedCount += BinCounts[Split];
+		LeftCosts[Split] = HalfArea(Accumulated) * AccumulatedCount;
+	}
+
+	int32 BestSplit = INDEX_NONE;
+	double BestCost = TNumericLimits<double>::Max();
+	Accumulated.Init();
+	AccumulatedCount = 0;
+	for (int32 Split = NumSplitBins - 2; Split >= 0; Split--)
+	{
+		Accumulated += BinBounds[Split + 1];
+		AccumulatedCount += BinCounts[Split + 1];
+		const double Cost = LeftCosts[Split] + HalfArea(Accumulated) * AccumulatedCount;
+		if (AccumulatedCount > 0 && AccumulatedCount < Count && Cost < BestCost)
+		{
+			BestCost = Cost;
+			BestSplit = Split;
+		}
+	}
+
+	int32 LeftCount = 0;
+	if (BestSplit != INDEX_NONE)
+	{
+		LeftCount = Algo::Partition(PrimitiveOrder.GetData() + First, Count, [&](int32 Primitive) { return GetBin(Primitive) <= BestSplit; });
+	}
+	if (LeftCount == 0 || LeftCount == Count)
+	{
+		// Every center fell in one bin, split in the middle of the order instead
+		LeftCount = Count / 2;
+	}
+
+	BuildNode(First, LeftCount, Centers);
+	const int32 RightChild = BuildNode(First + LeftCount, Count - LeftCount, Centers);
+	Nodes[NodeIndex].Index = RightChild;
+	return NodeIndex;
+}
+
+void FFragmentBVH::Query(TFunctionRef<bool(const FBox&)> Overlaps, TFunctionRef<void(int32 Primitive)> Visitor) const
+{
+	if (Nodes.Num() == 0) return;
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+	while (Stack.Num() > 0)
+	{
+		const int32 NodeIndex = Stack.Pop();
+		const FNode& Node = Nodes[NodeIndex];
+		if (!Overlaps(Node.Bounds)) continue;
+
+		if (Node.NumPrimitives > 0)
+		{
+			for (int32 Slot = Node.Index; Slot < Node.Index + Node.NumPrimitives; Slot++)
+			{
+				const int32 Primitive = PrimitiveOrder[Slot];
+				if (Overlaps(Boxes[Primitive]))
+				{
+					Visitor(Primitive);
+				}
+			}
+		}
+		else
+		{
+			Stack.Add(Node.Index);
+			Stack.Add(NodeIndex + 1);
+		}
+	}
+}
+
+void FFragmentBVH::QueryBox(const FBox& Box, TArray<int32>& OutPrimitives) const
+{
+	if (!Box.IsValid) return;
+
+	Query([&Box](const FBox& Bounds) { return Bounds.Intersect(Box); },
+		[&OutPrimitives](int32 Primitive) { OutPrimitives.Add(Primitive); });
+}
+
+void FFragmentBVH::QuerySphere(const FSphere& Sphere, TArray<int32>& OutPrimitives) const
+{
+	const double RadiusSquared = FMath::Square(Sphere.W);
+	Query([&Sphere, RadiusSquared](const FBox& Bounds) { return Bounds.ComputeSquaredDistanceToPoint(Sphere.Center) <= RadiusSquared; },
+		[&OutPrimitives](int32 Primitive) { OutPrimitives.Add(Primitive); });
+}
+
+void FFragmentBVH::QueryFrustum(const FConvexVolume& Frustum, TArray<int32>& OutPrimitives) const
+{
+	Query([&Frustum](const FBox& Bounds) { return Frustum.IntersectBox(Bounds.GetCenter(), Bounds.GetExtent()); },
+		[&OutPrimitives](int32 Primitive) { OutPrimitives.Add(Primitive); });
+}
+
+int32 FFragmentBVH::FindNearest(const FVector& Point, double* OutDistance) const
+{
+	if (Nodes.Num() == 0) return INDEX_NONE;
+
+	// Best first: always open the node closest to Point, stop once nothing left can beat the best primitive
+	TArray<TPair<double, int32>> Heap;
+	const auto HeapOrder = [](const TPair<double, int32>& A, const TPair<double, int32>& B) { return A.Key < B.Key; };
+	Heap.HeapPush(TPair<double, int32>(Nodes[0].Bounds.ComputeSquaredDistanceToPoint(Point), 0), HeapOrder);
+
+	int32 BestPrimitive = INDEX_NONE;
+	double BestDistanceSquared = TNumericLimits<double>::Max();
+	while (Heap.Num() > 0)
+	{
+		TPair<double, int32> Entry;
+		Heap.HeapPop(Entry, HeapOrder);
+		if (Entry.Key >= BestDistanceSquared) break;
+
+		const FNode& Node = Nodes[Entry.Value];
+		if (Node.NumPrimitives > 0)
+		{
+			for (int32 Slot = Node.Index; Slot < Node.Index + Node.NumPrimitives; Slot++)
+			{
+				const int32 Primitive = PrimitiveOrder[Slot];
+				const double DistanceSquared = Boxes[Primitive].ComputeSquaredDistanceToPoint(Point);
+				if (DistanceSquared < BestDistanceSquared)
+				{
+					BestDistanceSquared = DistanceSquared;
+					BestPrimitive = Primitive;
+				}
+			}
+		}
+		else
+		{
+			const int32 Children[2] = { Entry.Value + 1, Node.Index };
+			for (const int32 Child : Children)
+			{
+				const double DistanceSquared = Nodes[Child].Bounds.ComputeSquaredDistanceToPoint(Point);
+				if (DistanceSquared < BestDistanceSquared)
+				{
+					Heap.HeapPush(TPair<double, int32>(DistanceSquared, Child), HeapOrder);
+				}
+			}
+		}
+	}
+
+	if (OutDistance && BestPrimitive != INDEX_NONE)
+	{
+		*OutDistance = FMath::Sqrt(BestDistanceSquared);
+	}
+	return BestPrimitive;
+}
+
+int32 FFragmentBVH::Raycast(const FVector& Origin, const FVector& Direction, double MaxDistance, TFunctionRef<double(int32 Primitive, double ClosestDistance)> Visitor, double* OutDistance) const
+{
+	if (Nodes.Num() == 0) return INDEX_NONE;
+
+	// Huge instead of infinite for axis parallel rays, so the slab test never multiplies zero by infinity
+	FVector InvDirection;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const double Component = FMath::Abs(Direction[Axis]) > UE_DOUBLE_SMALL_NUMBER ? Direction[Axis] : UE_DOUBLE_SMALL_NUMBER;
+		InvDirection[Axis] = 1.0 / Component;
+	}
+
+	int32 BestPrimitive = INDEX_NONE;
+	double BestDistance = MaxDistance;
+
+	double RootEntry = 0.0;
+	if (!IntersectRayBox(Nodes[0].Bounds, Origin, InvDirection, BestDistance, RootEntry)) return INDEX_NONE;
+
+	TArray<TPair<int32, double>, TInlineAllocator<64>> Stack;
+	Stack.Emplace(0, RootEntry);
+	while (Stack.Num() > 0)
+	{
+		const TPair<int32, double> Entry = Stack.Pop();
+		if (Entry.Value > BestDistance) continue;
+
+		const FNode& Node = Nodes[Entry.Key];
+		if (Node.NumPrimitives > 0)
+		{
+			for (int32 Slot = Node.Index; Slot < Node.Index + Node.NumPrimitives; Slot++)
+			{
+				const int32 Primitive = PrimitiveOrder[Slot];
+				double BoxEntry = 0.0;
+				if (!IntersectRayBox(Boxes[Primitive], Origin, InvDirection, BestDistance, BoxEntry)) continue;
+
+				const double Distance = Visitor(Primitive, BestDistance);
+				if (Distance >= 0.0 && Distance < BestDistance)
+				{
+					BestDistance = Distance;
+					BestPrimitive = Primitive;
+				}
+			}
+			continue;
+		}
+
+		const int32 Left = Entry.Key + 1;
+		const int32 Right = Node.Index;
+		double LeftEntry = 0.0, RightEntry = 0.0;
+		const bool bHitLeft = IntersectRayBox(Nodes[Left].Bounds, Origin, InvDirection, BestDistance, LeftEntry);
+		const bool bHitRight = IntersectRayBox(Nodes[Right].Bounds, Origin, InvDirection, BestDistance, RightEntry);
+
+		// Push the far child first so the near one is opened next
+		if (bHitLeft && bHitRight)
+		{
+			if (LeftEntry <= RightEntry)
+			{
+				Stack.Emplace(Right, RightEntry);
+				Stack.Emplace(Left, LeftEntry);
+			}
+			else
+			{
+				Stack.Emplace(Left, LeftEntry);
+				Stack.Emplace(Right, RightEntry);
+			}
+		}
+		else if (bHitLeft)
+		{
+			Stack.Emplace(Left, LeftEntry);
+		}
+		else if (bHitRight)
+		{
+			Stack.Emplace(Right, RightEntry);
+		}
+	}
+
+	if (OutDistance && BestPrimitive != INDEX_NONE)
+	{
+		*OutDistance = BestDistance;
+	}
+	return BestPrimitive;
+}
@@ -0,0 +1,189 @@
+
+
+#include "Importer/FragmentGeometryCache.h"
+#include "Importer/FragmentsImporter.h"
+#include "DynamicMesh/DynamicMesh3.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	constexpr uint32 GeometryCacheMagic = 0x43475246; // "FRGC"
+}
+
+void FFragmentGeometryCache::Reset()
+{
+	FScopeLock Lock(&Mutex);
+	Entries.Reset();
+	Positions.Reset();
+	Indices.Reset();
+	EntryByHash.Reset();
+	bDirty = false;
+}
+
+void FFragmentGeometryCache::SetSettingsHash(uint32 InSettingsHash)
+{
+	if (InSettingsHash == SettingsHash) return;
+
+	Reset();
+	SettingsHash = InSettingsHash;
+}
+
+bool FFragmentGeometryCache::Load()
+{
+	Reset();
+	if (FilePath.IsEmpty()) return false;
+
+	TArray64<uint8> FileData;
+	if (!FFileHelper::LoadFileToArray(FileData, *FilePath, FILEREAD_Silent)) return false;
+
+	if (FileData.Num() < (int64)sizeof(FHeader))
+	{
+		UE_LOG(LogFragments, Warning, TEXT("Geometry cache too small, ignoring it: %s"), *FilePath);
+		return false;
+	}
+
+	FHeader Header;
+	FMemory::Memcpy(&Header, FileData.GetData(), sizeof(FHeader));
+	if (Header.Magic != GeometryCacheMagic || Header.Version != Version || Header.SettingsHash != SettingsHash)
+	{
+		UE_LOG(LogFragments, Log, TEXT("Geometry cache is from another version or build settings, it will be rebuilt: %s"), *FilePath);
+		return false;
+	}
+
+	const int64 EntriesSize = (int64)Header.NumEntries * sizeof(FEntry);
+	const int64 PositionsSize = (int64)Header.NumPositions * sizeof(FVector3f);
+	const int64 IndicesSize = (int64)Header.NumIndices * sizeof(uint32);
+	const uint8* Payload = FileData.GetData() + sizeof(FHeader);
+	const int64 PayloadSize = FileData.Num() - sizeof(FHeader);
+
+	if (PayloadSize != EntriesSize + PositionsSize + IndicesSize || FCrc::MemCrc32(Payload, PayloadSize) != Header.PayloadCrc)
+	{
+		UE_LOG(LogFragments, Warning, TEXT("Geometry cache is corrupted, it will be rebuilt: %s"), *FilePath);
+		return false;
+	}
+
+	FScopeLock Lock(&Mutex);
+	Entries.SetNumUninitialized(Header.NumEntries);
+	Positions.SetNumUninitialized(Header.NumPositions);
+	Indices.SetNumUninitialized(Header.NumIndices);
+	FMemory::Memcpy(Entries.GetData(), Payload, EntriesSize);
+	FMemory::Memcpy(Positions.GetData(), Payload + EntriesSize, PositionsSize);
+	FMemory::Memcpy(Indices.GetData(), Payload + EntriesSize + PositionsSize, IndicesSize);
+
+	EntryByHash.Reserve(Entries.Num());
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); EntryIndex++)
+	{
+		const FEntry& Entry = Entries[EntryIndex];
+		if ((uint64)Entry.FirstPosition + Entry.NumPositions > (uint64)Positions.Num() || (uint64)Entry.FirstIndex + Entry.NumIndices > (uint64)Indices.Num())
+		{
+			UE_LOG(LogFragments, Warning, TEXT("Geometry cache has an invalid entry, it will be rebuilt: %s"), *FilePath);
+			Entries.Reset();
+			Positions.Reset();
+			Indices.Reset();
+			EntryByHash.Reset();
+			return false;
+		}
+		EntryByHash.Add(Entry.GeometryHash, EntryIndex);
+	}
+
+	return true;
+}
+
+bool FFragmentGeometryCache::Save()
+{
+	if (FilePath.IsEmpty()) return false;
+
+	TArray64<uint8> FileData;
+	{
+		FScopeLock Lock(&Mutex);
+		if (!bDirty) return true;
+
+		const int64 EntriesSize = (int64)Entries.Num() * sizeof(FEntry);
+		const int64 PositionsSize = (int64)Positions.Num() * sizeof(FVector3f);
+		const int64 IndicesSize = (int64)Indices.Num() * sizeof(uint32);
+
+		FileData.SetNumUninitialized(sizeof(FHeader) + EntriesSize + PositionsSize + IndicesSize);
+		uint8* Payload = FileData.GetData() + sizeof(FHeader);
+		FMemory::Memcpy(Payload, Entries.GetData(), EntriesSize);
+		FMemory::Memcpy(Payload + EntriesSize, Positions.GetData(), PositionsSize);
+		FMemory::Memcpy(Payload + EntriesSize + PositionsSize, Indices.GetData(), IndicesSize);
+
+		FHeader Header;
+		Header.Magic = GeometryCacheMagic;
+		Header.Version = Version;
+		Header.SettingsHash = SettingsHash;
+		Header.NumEntries = Entries.Num();
+		Header.NumPositions = Positions.Num();
+		Header.NumIndices = Indices.Num();
+		Header.PayloadCrc = FCrc::MemCrc32(Payload, EntriesSize + PositionsSize + IndicesSize);
+		FMemory::Memcpy(FileData.GetData(), &Header, sizeof(FHeader));
+
+		bDirty = false;
+	}
+
+	if (!FFileHelper::SaveArrayToFile(FileData, *FilePath))
+	{
+		UE_LOG(LogFragments, Warning, TEXT("Failed to write geometry cache: %s"), *FilePath);
+		return false;
+	}
+	return true;
+}
+
+bool FFragmentGeometryCache::Find(uint64 GeometryHash, FDynamicMesh3& OutMesh) const
+{
+	FScopeLock Lock(&Mutex);
+
+	const int32* EntryIndex = EntryByHash.Find(GeometryHash);
+	if (!EntryIndex) return false;
+
+	const FEntry& Entry = Entries[*EntryIndex];
+	OutMesh.Clear();
+	for (uint32 i = 0; i < Entry.NumPositions; i++)
+	{
+		OutMesh.AppendVertex(FVector3d(Positions[Entry.FirstPosition + i]));
+	}
+	for (uint32 i = 0; i + 2 < Entry.NumIndices; i += 3)
+	{
+		const uint32* Triangle = &Indices[Entry.FirstIndex + i];
+		OutMesh.AppendTriangle(Triangle[0], Triangle[1], Triangle[2]);
+	}
+	return true;
+}
+
+void FFragmentGeometryCache::Add(uint64 GeometryHash, const FDynamicMesh3& Mesh)
+{
+	FScopeLock Lock(&Mutex);
+	if (EntryByHash.Contains(GeometryHash)) return;
+
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.GeometryHash = GeometryHash;
+	Entry.FirstPosition = Positions.Num();
+	Entry.FirstIndex = Indices.Num();
+
+	// Vertex ids may have gaps, store them densely
+	TArray<int32> VertexRemap;
+	VertexRemap.Init(INDEX_NONE, Mesh.MaxVertexID());
+	for (const int32 VertexId : Mesh.VertexIndicesItr())
+	{
+		VertexRemap[VertexId] = Positions.Num() - Entry.FirstPosition;
+		Positions.Add(FVector3f(Mesh.GetVertex(VertexId)));
+	}
+	for (const int32 TriangleId : Mesh.TriangleIndicesItr())
+	{
+		const UE::Geometry::FIndex3i Triangle = Mesh.GetTriangle(TriangleId);
+		Indices.Add(VertexRemap[Triangle.A]);
+		Indices.Add(VertexRemap[Triangle.B]);
+		Indices.Add(VertexRemap[Triangle.C]);
+	}
+
+	Entry.NumPositions = Positions.Num() - Entry.FirstPosition;
+	Entry.NumIndices = Indices.Num() - Entry.FirstIndex;
+	EntryByHash.Add(GeometryHash, Entries.Num() - 1);
+	bDirty = true;
+}
+
+int32 FFragmentGeometryCache::Num() const
+{
+	FScopeLock Lock(&Mutex);
+	return Entries.Num();
+}
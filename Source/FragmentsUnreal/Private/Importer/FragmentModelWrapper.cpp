@@ -2,4 +2,186 @@
 
 
 #include "Importer/FragmentModelWrapper.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/ParallelFor.h"
+#include "DynamicMesh/DynamicMesh3.h"
 
+namespace
+{
+	// Rays only touch a small part of a model, this keeps its picking meshes around a few tens of MB
+	constexpr int32 MaxPickingMeshVertices = 1000000;
+}
+
+bool UFragmentModelWrapper::LoadMappedModel(const FString& FragPath)
+{
+	ReleaseMapping();
+
+	IMappedFileHandle* Handle = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FragPath);
+	if (!Handle)
+	{
+		return false;
+	}
+	MappedHandle.Reset(Handle);
+
+	IMappedFileRegion* Region = MappedHandle->MapRegion(0, MappedHandle->GetFileSize());
+	if (!Region)
+	{
+		ReleaseMapping();
+		return false;
+	}
+	MappedRegion.Reset(Region);
+
+	RawBuffer.Empty();
+	ParsedModel = GetModel(MappedRegion->GetMappedPtr());
+	BuildModelIndices();
+	return true;
+}
+
+void UFragmentModelWrapper::BuildModelIndices()
+{
+	LocalIdToIndex.Reset();
+	CategoryIndex.Reset();
+	AttributeTable.Build(ParsedModel);
+	RelationIndex.Build(ParsedModel);
+	if (!ParsedModel || !ParsedModel->local_ids()) return;
+
+	const auto* LocalIds = ParsedModel->local_ids();
+	LocalIdToIndex.Reserve(LocalIds->size());
+	for (flatbuffers::uoffset_t i = 0; i < LocalIds->size(); i++)
+	{
+		// Keep the first occurrence, as the linear lookup did
+		LocalIdToIndex.FindOrAdd(LocalIds->Get(i), static_cast<int32>(i));
+	}
+
+	const auto* Categories = ParsedModel->categories();
+	if (!Categories) return;
+
+	// Items of one category are usually stored together, so reuse the last bucket while the raw string repeats
+	const char* LastCategory = nullptr;
+	TArray<int32>* LastBucket = nullptr;
+	const flatbuffers::uoffset_t NumItems = FMath::Min(Categories->size(), LocalIds->size());
+	for (flatbuffers::uoffset_t i = 0; i < NumItems; i++)
+	{
+		const auto* Category = Categories->Get(i);
+		if (!Category) continue;
+
+		if (!LastBucket || FCStringAnsi::Strcmp(LastCategory, Category->c_str()) != 0)
+		{
+			LastCategory = Category->c_str();
+			LastBucket = &CategoryIndex.FindOrAdd(UTF8_TO_TCHAR(LastCategory));
+		}
+		LastBucket->Add(LocalIds->Get(i));
+	}
+}
+
+void UFragmentModelWrapper::SetItems(TArray<FFragmentItem>&& InItems)
+{
+	Items = MoveTemp(InItems);
+
+	LocalIdToItem.Reset();
+	LocalIdToItem.Reserve(Items.Num());
+	for (int32 Slot = 0; Slot < Items.Num(); Slot++)
+	{
+		// Items are stored depth first, keep the first match as the recursive search did
+		if (Items[Slot].LocalId != INDEX_NONE)
+		{
+			LocalIdToItem.FindOrAdd(Items[Slot].LocalId, Slot);
+		}
+	}
+}
+
+void UFragmentModelWrapper::BuildSpatialIndex()
+{
+	SpatialIndex.Reset();
+	SpatialSamples.Reset();
+	SpatialTransforms.Reset();
+
+	const Meshes* MeshesRef = ParsedModel ? ParsedModel->meshes() : nullptr;
+	if (!MeshesRef || !MeshesRef->representations() || !MeshesRef->local_transforms() || Items.Num() == 0) return;
+
+	// Item transforms are relative to their parent, parents come before their children
+	TArray<FTransform> ItemToModel;
+	ItemToModel.SetNum(Items.Num());
+	for (int32 Slot = 0; Slot < Items.Num(); Slot++)
+	{
+		const int32 ParentIndex = Items[Slot].ParentIndex;
+		ItemToModel[Slot] = ParentIndex != INDEX_NONE ? Items[Slot].GlobalTransform * ItemToModel[ParentIndex] : Items[Slot].GlobalTransform;
+
+		for (int32 SampleIndex = 0; SampleIndex < Items[Slot].Samples.Num(); SampleIndex++)
+		{
+			SpatialSamples.Emplace(Slot, SampleIndex);
+		}
+	}
+
+	TArray<FBox> Boxes;
+	Boxes.SetNumUninitialized(SpatialSamples.Num());
+	SpatialTransforms.SetNum(SpatialSamples.Num());
+	ParallelFor(SpatialSamples.Num(), [this, MeshesRef, &ItemToModel, &Boxes](int32 Primitive)
+	{
+		const FIntPoint& Entry = SpatialSamples[Primitive];
+		const FFragmentSample& Sample = Items[Entry.X].Samples[Entry.Y];
+		Boxes[Primitive] = FBox(ForceInit);
+		SpatialTransforms[Primitive] = ItemToModel[Entry.X];
+
+		if (Sample.RepresentationIndex < 0 || (flatbuffers::uoffset_t)Sample.RepresentationIndex >= MeshesRef->representations()->size()) return;
+		if (Sample.LocalTransformIndex < 0 || (flatbuffers::uoffset_t)Sample.LocalTransformIndex >= MeshesRef->local_transforms()->size()) return;
+
+		const FBox RepresentationBox = UFragmentsUtils::MakeBox(MeshesRef->representations()->Get(Sample.RepresentationIndex)->bbox());
+		if (!RepresentationBox.IsValid) return;
+
+		const FTransform LocalTransform = UFragmentsUtils::MakeTransform(MeshesRef->local_transforms()->Get(Sample.LocalTransformIndex));
+		SpatialTransforms[Primitive] = LocalTransform * ItemToModel[Entry.X];
+		Boxes[Primitive] = RepresentationBox.TransformBy(SpatialTransforms[Primitive]);
+	});
+
+	SpatialIndex.Build(MoveTemp(Boxes));
+}
+
+FTransform UFragmentModelWrapper::GetItemToModel(int32 Slot) const
+{
+	if (!Items.IsValidIndex(Slot)) return FTransform::Identity;
+
+	FTransform ItemToModel = Items[Slot].GlobalTransform;
+	for (int32 Parent = Items[Slot].ParentIndex; Parent != INDEX_NONE; Parent = Items[Parent].ParentIndex)
+	{
+		ItemToModel = ItemToModel * Items[Parent].GlobalTransform;
+	}
+	return ItemToModel;
+}
+
+bool UFragmentModelWrapper::IsItemInSubtree(int32 Slot, int32 AncestorSlot) const
+{
+	for (int32 Current = Slot; Items.IsValidIndex(Current); Current = Items[Current].ParentIndex)
+	{
+		if (Current == AncestorSlot) return true;
+	}
+	return false;
+}
+
+const FDynamicMesh3* UFragmentModelWrapper::AddPickingMesh(uint64 GeometryHash, FDynamicMesh3&& Mesh)
+{
+	if (PickingMeshVertices + Mesh.VertexCount() > MaxPickingMeshVertices)
+	{
+		PickingMeshes.Empty();
+		PickingMeshVertices = 0;
+	}
+
+	PickingMeshVertices += Mesh.VertexCount();
+	return &PickingMeshes.Add(GeometryHash, MoveTemp(Mesh));
+}
+
+void UFragmentModelWrapper::GetSpatialLocalIds(TConstArrayView<int32> Primitives, TArray<int32>& OutLocalIds) const
+{
+	TSet<int32> Seen;
+	Seen.Reserve(Primitives.Num());
+	for (const int32 Primitive : Primitives)
+	{
+		const int32 LocalId = Items[SpatialSamples[Primitive].X].LocalId;
+		bool bAlreadySeen = false;
+		Seen.Add(LocalId, &bAlreadySeen);
+		if (!bAlreadySeen)
+		{
+			OutLocalIds.Add(LocalId);
+		}
+	}
+}
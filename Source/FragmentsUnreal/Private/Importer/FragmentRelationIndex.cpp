@@ -0,0 +1,178 @@
+
+
+#include "Importer/FragmentRelationIndex.h"
+
+namespace
+{
+	struct FParsedEdge
+	{
+		int32 SourceSlot;
+		int32 RelationType;
+		int32 Target;
+	};
+
+	// Splits a raw ["RelationName", LocalId, LocalId, ...] relation into tokens without brackets, quotes or spaces
+	void TokenizeRawRelation(const ANSICHAR* Raw, int32 RawLength, TArray<TArray<ANSICHAR, TInlineAllocator<64>>, TInlineAllocator<16>>& OutTokens)
+	{
+		OutTokens.Reset();
+		OutTokens.AddDefaulted();
+		for (int32 i = 0; i < RawLength; i++)
+		{
+			const ANSICHAR C = Raw[i];
+			if (C == ',')
+			{
+				if (OutTokens.Last().Num() > 0) OutTokens.AddDefaulted();
+				continue;
+			}
+			if (C == '[' || C == ']' || C == '"' || FCharAnsi::IsWhitespace(C)) continue;
+			OutTokens.Last().Add(C);
+		}
+		if (OutTokens.Last().Num() == 0) OutTokens.Pop(EAllowShrinking::No);
+
+		for (auto& Token : OutTokens)
+		{
+			Token.Add('\0');
+		}
+	}
+}
+
+void FFragmentRelationIndex::Reset()
+{
+	RelationNames.Reset();
+	RelationTypeIds.Reset();
+	SourceSlots.Reset();
+	EdgeOffsets.Reset();
+	EdgeTypes.Reset();
+	EdgeTargets.Reset();
+}
+
+void FFragmentRelationIndex::Build(const Model* InModel)
+{
+	Reset();
+	if (!InModel || !InModel->relations() || !InModel->relations_items()) return;
+
+	const auto* relations = InModel->relations();
+	const auto* relations_items = InModel->relations_items();
+	const flatbuffers::uoffset_t NumRelations = FMath::Min(relations->size(), relations_items->size());
+
+	TArray<FParsedEdge> ParsedEdges;
+	TArray<int32> EdgeCounts;
+	TArray<TArray<ANSICHAR, TInlineAllocator<64>>, TInlineAllocator<16>> Tokens;
+
+	for (flatbuffers::uoffset_t i = 0; i < NumRelations; i++)
+	{
+		const auto* Relation = relations->Get(i);
+		if (!Relation || !Relation->data()) continue;
+
+		const int32 SourceLocalId = relations_items->Get(i);
+		int32 SourceSlot = INDEX_NONE;
+		if (const int32* Found = SourceSlots.Find(SourceLocalId))
+		{
+			SourceSlot = *Found;
+		}
+		else
+		{
+			SourceSlot = EdgeCounts.Add(0);
+			SourceSlots.Add(SourceLocalId, SourceSlot);
+		}
+
+		for (flatbuffers::uoffset_t j = 0; j < Relation->data()->size(); j++)
+		{
+			const auto* Raw = Relation->data()->Get(j);
+			if (!Raw) continue;
+
+			TokenizeRawRelation(Raw->c_str(), Raw->size(), Tokens);
+			if (Tokens.Num() < 2) continue;
+
+			const FString RelationName = UTF8_TO_TCHAR(Tokens[0].GetData());
+			int32 RelationType = INDEX_NONE;
+			if (const int32* Found = RelationTypeIds.Find(RelationName))
+			{
+				RelationType = *Found;
+			}
+			else
+			{
+				RelationType = RelationNames.Add(RelationName);
+				RelationTypeIds.Add(RelationName, RelationType);
+			}
+
+			for (int32 k = 1; k < Tokens.Num(); ++k)
+			{
+				// Drop tokens that are not a whole integer instead of letting Atoi turn them into LocalId 0
+				const ANSICHAR* Token = Tokens[k].GetData();
+				ANSICHAR* End = nullptr;
+				const int32 Target = FCStringAnsi::Strtoi(Token, &End, 10);
+				if (End == Token || *End != '\0') continue;
+
+				ParsedEdges.Add({ SourceSlot, RelationType, Target });
+				EdgeCounts[SourceSlot]++;
+			}
+		}
+	}
+
+	// Counting sort by source, stable so every source keeps its edges in model order
+	EdgeOffsets.SetNumUninitialized(EdgeCounts.Num() + 1);
+	EdgeOffsets[0] = 0;
+	for (int32 Slot = 0; Slot < EdgeCounts.Num(); Slot++)
+	{
+		EdgeOffsets[Slot + 1] = EdgeOffsets[Slot] + EdgeCounts[Slot];
+	}
+
+	EdgeTypes.SetNumUninitialized(ParsedEdges.Num());
+	EdgeTargets.SetNumUninitialized(ParsedEdges.Num());
+	TArray<int32> Cursor(EdgeOffsets.GetData(), EdgeCounts.Num());
+	for (const FParsedEdge& Edge : ParsedEdges)
+	{
+		const int32 Dest = Cursor[Edge.SourceSlot]++;
+		EdgeTypes[Dest] = Edge.RelationType;
+		EdgeTargets[Dest] = Edge.Target;
+	}
+}
+
+int32 FFragmentRelationIndex::FindRelationType(const FString& RelationName) const
+{
+	const int32* Found = RelationTypeIds.Find(RelationName);
+	return Found ? *Found : INDEX_NONE;
+}
+
+int32 FFragmentRelationIndex::GetFirstEdge(int32 LocalId) const
+{
+	const int32* Slot = SourceSlots.Find(LocalId);
+	return Slot ? EdgeOffsets[*Slot] : 0;
+}
+
+int32 FFragmentRelationIndex::GetNumEdges(int32 LocalId) const
+{
+	const int32* Slot = SourceSlots.Find(LocalId);
+	return Slot ? EdgeOffsets[*Slot + 1] - EdgeOffsets[*Slot] : 0;
+}
+
+void FFragmentRelationIndex::ForEachRelated(int32 LocalId, TConstArrayView<int32> RelationTypes, TFunctionRef<void(int32 RelationType, int32 TargetLocalId)> Visitor) const
+{
+	const int32* Slot = SourceSlots.Find(LocalId);
+	if (!Slot) return;
+
+	for (int32 Edge = EdgeOffsets[*Slot]; Edge < EdgeOffsets[*Slot + 1]; Edge++)
+	{
+		if (RelationTypes.Contains(EdgeTypes[Edge]))
+		{
+			Visitor(EdgeTypes[Edge], EdgeTargets[Edge]);
+		}
+	}
+}
+
+void FFragmentRelationIndex::GetRelated(int32 LocalId, TConstArrayView<int32> RelationTypes, TArray<int32>& OutLocalIds) const
+{
+	ForEachRelated(LocalId, RelationTypes, [&OutLocalIds](int32 RelationType, int32 TargetLocalId)
+		{
+			OutLocalIds.Add(TargetLocalId);
+		});
+}
+
+void FFragmentRelationIndex::GetRelated(int32 LocalId, const FString& RelationName, TArray<int32>& OutLocalIds) const
+{
+	const int32 RelationType = FindRelationType(RelationName);
+	if (RelationType == INDEX_NONE) return;
+
+	GetRelated(LocalId, MakeArrayView(&RelationType, 1), OutLocalIds);
+}
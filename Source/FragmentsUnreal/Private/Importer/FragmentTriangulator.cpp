@@ -0,0 +1,542 @@
+
+
+#include "Importer/FragmentTriangulator.h"
+#include "Importer/FragmentsImporter.h"
+#include "Utils/FragmentsUtils.h"
+#include "Misc/MemStack.h"
+#include "Algo/Reverse.h"
+#include "tesselator.h"
+
+namespace
+{
+	// Same tolerance the tess path used to drop repeated points
+	constexpr double PointTolerance = 0.001;
+	constexpr double AreaTolerance = 1e-6;
+
+	// Past this size ear clipping gets slower than libtess2
+	constexpr int32 MaxEarClippingPoints = 256;
+
+	// The arena is only released with the tesselator, drop both once profiles have used this much
+	constexpr int32 MaxArenaBytes = 4 * 1024 * 1024;
+
+	// Allocations keep their size in front of them for realloc
+	constexpr uint32 ArenaHeaderSize = 16;
+
+	double Orientation(const FVector2D& A, const FVector2D& B, const FVector2D& C)
+	{
+		return FVector2D::CrossProduct(B - A, C - B);
+	}
+
+	bool SegmentsIntersect(const FVector2D& A, const FVector2D& B, const FVector2D& C, const FVector2D& D)
+	{
+		const double O1 = FVector2D::CrossProduct(B - A, C - A);
+		const double O2 = FVector2D::CrossProduct(B - A, D - A);
+		const double O3 = FVector2D::CrossProduct(D - C, A - C);
+		const double O4 = FVector2D::CrossProduct(D - C, B - C);
+
+		if (((O1 > AreaTolerance && O2 < -AreaTolerance) || (O1 < -AreaTolerance && O2 > AreaTolerance))
+			&& ((O3 > AreaTolerance && O4 < -AreaTolerance) || (O3 < -AreaTolerance && O4 > AreaTolerance)))
+		{
+			return true;
+		}
+
+		// Touching or overlapping
+		auto OnSegment = [](const FVector2D& P, const FVector2D& S0, const FVector2D& S1, double O)
+			{
+				return FMath::Abs(O) <= AreaTolerance
+					&& P.X >= FMath::Min(S0.X, S1.X) - PointTolerance && P.X <= FMath::Max(S0.X, S1.X) + PointTolerance
+					&& P.Y >= FMath::Min(S0.Y, S1.Y) - PointTolerance && P.Y <= FMath::Max(S0.Y, S1.Y) + PointTolerance;
+			};
+		return OnSegment(C, A, B, O1) || OnSegment(D, A, B, O2) || OnSegment(A, C, D, O3) || OnSegment(B, C, D, O4);
+	}
+
+	bool IsSelfIntersecting(const TArray<FVector2D>& Polygon)
+	{
+		const int32 Num = Polygon.Num();
+		for (int32 i = 0; i < Num; i++)
+		{
+			const FVector2D& A = Polygon[i];
+			const FVector2D& B = Polygon[(i + 1) % Num];
+
+			// Skip the edge itself and its two neighbours
+			for (int32 j = i + 2; j < Num; j++)
+			{
+				if (i == 0 && j == Num - 1) continue;
+				if (SegmentsIntersect(A, B, Polygon[j], Polygon[(j + 1) % Num])) return true;
+			}
+		}
+		return false;
+	}
+
+	// Every turn goes the same way and they add up to a single revolution. Star shaped contours turn the same way
+	// at each point too but wind around more than once.
+	bool IsConvex(const TArray<FVector2D>& Polygon)
+	{
+		const int32 Num = Polygon.Num();
+		double TotalTurn = 0.0;
+		for (int32 i = 0; i < Num; i++)
+		{
+			const FVector2D EdgeA = Polygon[(i + 1) % Num] - Polygon[i];
+			const FVector2D EdgeB = Polygon[(i + 2) % Num] - Polygon[(i + 1) % Num];
+			const double Cross = FVector2D::CrossProduct(EdgeA, EdgeB);
+			if (Cross < -AreaTolerance) return false;
+			TotalTurn += FMath::Atan2(Cross, FVector2D::DotProduct(EdgeA, EdgeB));
+		}
+		return FMath::IsNearlyEqual(TotalTurn, UE_DOUBLE_TWO_PI, 1e-3);
+	}
+
+	bool IsInsideTriangle(const FVector2D& P, const FVector2D& A, const FVector2D& B, const FVector2D& C)
+	{
+		return Orientation(A, B, P) >= -AreaTolerance && Orientation(B, C, P) >= -AreaTolerance && Orientation(C, A, P) >= -AreaTolerance;
+	}
+
+	// Counter clockwise simple polygon. Appends positions of triangles, returns false if no ear is found.
+	bool EarClip(const TArray<FVector2D>& Polygon, TArray<int32>& OutTriangles)
+	{
+		TArray<int32, TInlineAllocator<64>> Remaining;
+		Remaining.SetNumUninitialized(Polygon.Num());
+		for (int32 i = 0; i < Polygon.Num(); i++)
+		{
+			Remaining[i] = i;
+		}
+
+		int32 Current = 0;
+		while (Remaining.Num() > 3)
+		{
+			const int32 Count = Remaining.Num();
+			bool bFoundEar = false;
+
+			for (int32 Step = 0; Step < Count; Step++, Current = (Current + 1) % Count)
+			{
+				const int32 Prev = Remaining[(Current + Count - 1) % Count];
+				const int32 Curr = Remaining[Current];
+				const int32 Next = Remaining[(Current + 1) % Count];
+				const FVector2D& A = Polygon[Prev];
+				const FVector2D& B = Polygon[Curr];
+				const FVector2D& C = Polygon[Next];
+
+				if (Orientation(A, B, C) <= AreaTolerance) continue;
+
+				bool bBlocked = false;
+				for (const int32 Other : Remaining)
+				{
+					if (Other == Prev || Other == Curr || Other == Next) continue;
+
+					const FVector2D& P = Polygon[Other];
+					if (P.Equals(A, PointTolerance) || P.Equals(B, PointTolerance) || P.Equals(C, PointTolerance)) continue;
+					if (IsInsideTriangle(P, A, B, C))
+					{
+						bBlocked = true;
+						break;
+					}
+				}
+				if (bBlocked) continue;
+
+				OutTriangles.Add(Prev);
+				OutTriangles.Add(Curr);
+				OutTriangles.Add(Next);
+				Remaining.RemoveAt(Current, 1, EAllowShrinking::No);
+				Current %= Remaining.Num();
+				bFoundEar = true;
+				break;
+			}
+
+			if (!bFoundEar) return false;
+		}
+
+		OutTriangles.Add(Remaining[0]);
+		OutTriangles.Add(Remaining[1]);
+		OutTriangles.Add(Remaining[2]);
+		return true;
+	}
+}
+
+FFragmentTriangulator::FFragmentTriangulator()
+{
+}
+
+FFragmentTriangulator::~FFragmentTriangulator()
+{
+	ReleaseTesselator();
+}
+
+bool FFragmentTriangulator::Triangulate(const TArray<FVector>& Points,
+	const TArray<int32>& Profile,
+	const TArray<TArray<int32>>& Holes,
+	TArray<FVector>& OutVertices,
+	TArray<int32>& OutIndices,
+	TArray<int32>* OutSourcePoints)
+{
+	if (Holes.Num() > 0)
+	{
+		return TriangulateWithTess(Points, Profile, Holes, OutVertices, OutIndices, OutSourcePoints);
+	}
+
+	const FPlaneProjection Projection = UFragmentsUtils::BuildProjectionPlane(Points, Profile);
+
+	Projected.Reset(Profile.Num());
+	Polygon.Reset(Profile.Num());
+	for (const int32 Index : Profile)
+	{
+		if (!Points.IsValidIndex(Index))
+		{
+			UE_LOG(LogFragments, Error, TEXT("Contour references invalid point %d, skipping."), Index);
+			return false;
+		}
+
+		const FVector2D P2d = Projection.Project(Points[Index]);
+		if (Projected.Num() > 0 && P2d.Equals(Projected.Last(), PointTolerance)) continue;
+		Projected.Add(P2d);
+		Polygon.Add(Index);
+	}
+	while (Projected.Num() > 1 && Projected.Last().Equals(Projected[0], PointTolerance))
+	{
+		Projected.Pop(EAllowShrinking::No);
+		Polygon.Pop(EAllowShrinking::No);
+	}
+
+	if (Projected.Num() < 3)
+	{
+		UE_LOG(LogFragments, Error, TEXT("Contour has fewer than 3 points, skipping."));
+		return false;
+	}
+
+	// Twice the signed area, positive when counter clockwise
+	double Area = 0.0;
+	for (int32 i = 0; i < Projected.Num(); i++)
+	{
+		Area += FVector2D::CrossProduct(Projected[i], Projected[(i + 1) % Projected.Num()]);
+	}
+	if (FMath::Abs(Area) <= AreaTolerance)
+	{
+		UE_LOG(LogFragments, Error, TEXT("Contour is colinear in 2D projection, skipping."));
+		return false;
+	}
+
+	// Same winding libtess2 produced for the outer contour
+	if (Area < 0.0)
+	{
+		Algo::Reverse(Projected);
+		Algo::Reverse(Polygon);
+	}
+
+	const int32 Num = Projected.Num();
+	const int32 FirstVertex = OutVertices.Num();
+	const int32 FirstIndex = OutIndices.Num();
+
+	const bool bConvex = IsConvex(Projected);
+	if (!bConvex && (Num > MaxEarClippingPoints || IsSelfIntersecting(Projected)))
+	{
+		return TriangulateWithTess(Points, Profile, Holes, OutVertices, OutIndices, OutSourcePoints);
+	}
+
+	OutVertices.Reserve(FirstVertex + Num);
+	for (const int32 Index : Polygon)
+	{
+		OutVertices.Add(Points[Index]);
+	}
+	if (OutSourcePoints)
+	{
+		OutSourcePoints->Append(Polygon);
+	}
+
+	// Triangles and convex polygons are fanned from their first point
+	if (bConvex)
+	{
+		OutIndices.Reserve(FirstIndex + (Num - 2) * 3);
+		for (int32 i = 1; i + 1 < Num; i++)
+		{
+			OutIndices.Add(FirstVertex);
+			OutIndices.Add(FirstVertex + i);
+			OutIndices.Add(FirstVertex + i + 1);
+		}
+		return true;
+	}
+
+	if (EarClip(Projected, OutIndices))
+	{
+		for (int32 i = FirstIndex; i < OutIndices.Num(); i++)
+		{
+			OutIndices[i] += FirstVertex;
+		}
+		return true;
+	}
+
+	OutVertices.SetNum(FirstVertex, EAllowShrinking::No);
+	OutIndices.SetNum(FirstIndex, EAllowShrinking::No);
+	if (OutSourcePoints)
+	{
+		OutSourcePoints->SetNum(OutSourcePoints->Num() - Num, EAllowShrinking::No);
+	}
+	return TriangulateWithTess(Points, Profile, Holes, OutVertices, OutIndices, OutSourcePoints);
+}
+
+bool FFragmentTriangulator::TriangulateWithTess(const TArray<FVector>& Points,
+	const TArray<int32>& Profile,
+	const TArray<TArray<int32>>& Holes,
+	TArray<FVector>& OutVertices,
+	TArray<int32>& OutIndices,
+	TArray<int32>* OutSourcePoints)
+{
+	TESStesselator* Tesselator = GetTesselator();
+	if (!Tesselator)
+	{
+		UE_LOG(LogFragments, Error, TEXT("Failed to create tesselator."));
+		return false;
+	}
+
+	FPlaneProjection Projection = UFragmentsUtils::BuildProjectionPlane(Points, Profile);
+
+	auto AddContour = [&](const TArray<int32>& Indices, bool bIsHole)
+		{
+			TArray<FVector2D> ContourPoints;
+			TArray<float> Contour;
+
+			for (int32 Index : Indices)
+			{
+				FVector2D P2d = Projection.Project(Points[Index]);
+				ContourPoints.Add(P2d);
+			}
+
+			if (ContourPoints.Num() < 3)
+			{
+				UE_LOG(LogFragments, Error, TEXT("Contour has fewer than 3 points, skipping."));
+				return;
+			}
+
+			// Check for colinearity
+			bool bColinear = true;
+			const FVector2D& A = ContourPoints[0];
+
+			for (int i = 1; i < ContourPoints.Num() - 1; ++i)
+			{
+				FVector2D Dir1 = (ContourPoints[i] - A).GetSafeNormal();
+				FVector2D Dir2 = (ContourPoints[i + 1] - ContourPoints[i]).GetSafeNormal();
+				if (!Dir1.Equals(Dir2, 0.001f))
+				{
+					bColinear = false;
+					break;
+				}
+			}
+			if (bColinear)
+			{
+				UE_LOG(LogFragments, Error, TEXT("Contour is colinear in 2D projection, skipping."));
+				return;
+			}
+
+			TArray<FVector2D> UniqueProjected;
+			UniqueProjected.Reserve(ContourPoints.Num());
+
+			for (int32 i = 0; i < ContourPoints.Num(); ++i)
+			{
+				if (i == 0 || !ContourPoints[i].Equals(ContourPoints[i - 1], PointTolerance))
+				{
+					UniqueProjected.Add(ContourPoints[i]);
+				}
+			}
+			ContourPoints = UniqueProjected;
+
+			// Fix winding
+			bool bClockwise = UFragmentsUtils::IsClockwise(ContourPoints);
+
+			if (!bIsHole && bClockwise)
+			{
+				Algo::Reverse(ContourPoints); // Outer should be CCW
+			}
+			else if (bIsHole && !bClockwise)
+			{
+				Algo::Reverse(ContourPoints); // Holes should be CW
+			}
+
+			for (const FVector2D& P : ContourPoints)
+			{
+				Contour.Add(P.X);
+				Contour.Add(P.Y);
+			}
+
+			tessAddContour(Tesselator, 2, Contour.GetData(), sizeof(float) * 2, ContourPoints.Num());
+		};
+
+	AddContour(Profile, false);
+
+	for (const TArray<int32>& Hole : Holes)
+	{
+		AddContour(Hole, true);
+	}
+
+	if (!tessTesselate(Tesselator, TESS_WINDING_ODD, TESS_POLYGONS, 3, 2, nullptr))
+	{
+		UE_LOG(LogFragments, Error, TEXT("tessTesselate failed."));
+
+		// A failed pass can leave a half built mesh behind, start over with a new tesselator
+		ReleaseTesselator();
+		return false;
+	}
+
+	const int32 VertexCount = tessGetVertexCount(Tesselator);
+	const TESSreal* Vertices = tessGetVertices(Tesselator);
+
+	if (VertexCount == 0)
+	{
+		for (const int32& P : Profile)
+		{
+			UE_LOG(LogFragments, Warning, TEXT("\tPoints of Vertex 0 X: %.6f, Y: %.6f, Z: %.6f"), Points[P].X, Points[P].Y, Points[P].Z);
+		}
+
+		int32 HoleIdx = 0;
+		for (const auto& H : Holes)
+		{
+			for (const int32& P : H)
+			{
+				UE_LOG(LogFragments, Warning, TEXT("\tPoints of Hole %d 0 X: %.6f, Y: %.6f, Z: %.6f"), HoleIdx, Points[P].X, Points[P].Y, Points[P].Z);
+			}
+			HoleIdx++;
+		}
+	}
+
+	// Tess vertices are appended in order, so an index only needs the offset of the first one
+	const int32 FirstOutVertex = OutVertices.Num();
+	OutVertices.Reserve(FirstOutVertex + VertexCount);
+	for (int32 i = 0; i < VertexCount; i++)
+	{
+		FVector2D P2d(Vertices[i * 2], Vertices[i * 2 + 1]);
+		OutVertices.Add(Projection.Unproject(P2d));
+	}
+	if (OutSourcePoints)
+	{
+		// Tess may merge, drop or create points, the welder matches them back by position
+		OutSourcePoints->Reserve(OutSourcePoints->Num() + VertexCount);
+		for (int32 i = 0; i < VertexCount; i++)
+		{
+			OutSourcePoints->Add(INDEX_NONE);
+		}
+	}
+	const int32* Indices = tessGetElements(Tesselator);
+	const int32 ElementCount = tessGetElementCount(Tesselator);
+	OutIndices.Reserve(OutIndices.Num() + ElementCount * 3);
+
+	for (int32 i = 0; i < ElementCount; ++i)
+	{
+		const int32* Poly = &Indices[i * 3];
+		for (int j = 0; j < 3; ++j)
+		{
+			int32 Idx = Poly[j];
+			if (Idx != TESS_UNDEF)
+			{
+				OutIndices.Add(FirstOutVertex + Idx);
+			}
+		}
+	}
+
+	if (Arena->GetByteCount() > MaxArenaBytes)
+	{
+		ReleaseTesselator();
+	}
+
+	return true;
+}
+
+TESStesselator* FFragmentTriangulator::GetTesselator()
+{
+	if (Tess) return Tess;
+
+	Arena = MakeUnique<FMemStackBase>();
+
+	// Profiles are small, keep the buckets small too
+	TESSalloc Alloc;
+	FMemory::Memzero(Alloc);
+	Alloc.memalloc = &FFragmentTriangulator::ArenaAlloc;
+	Alloc.memrealloc = &FFragmentTriangulator::ArenaRealloc;
+	Alloc.memfree = &FFragmentTriangulator::ArenaFree;
+	Alloc.userData = Arena.Get();
+	Alloc.meshEdgeBucketSize = 64;
+	Alloc.meshVertexBucketSize = 64;
+	Alloc.meshFaceBucketSize = 32;
+	Alloc.dictNodeBucketSize = 64;
+	Alloc.regionBucketSize = 32;
+
+	Tess = tessNewTess(&Alloc);
+	return Tess;
+}
+
+void FFragmentTriangulator::ReleaseTesselator()
+{
+	if (Tess)
+	{
+		tessDeleteTess(Tess);
+		Tess = nullptr;
+	}
+	Arena.Reset();
+}
+
+void* FFragmentTriangulator::ArenaAlloc(void* UserData, unsigned int Size)
+{
+	uint8* Block = static_cast<FMemStackBase*>(UserData)->PushBytes(Size + ArenaHeaderSize, ArenaHeaderSize);
+	*reinterpret_cast<unsigned int*>(Block) = Size;
+	return Block + ArenaHeaderSize;
+}
+
+void* FFragmentTriangulator::ArenaRealloc(void* UserData, void* Ptr, unsigned int Size)
+{
+	if (!Ptr) return ArenaAlloc(UserData, Size);
+
+	const unsigned int OldSize = *reinterpret_cast<unsigned int*>(static_cast<uint8*>(Ptr) - ArenaHeaderSize);
+	if (Size <= OldSize) return Ptr;
+
+	void* NewPtr = ArenaAlloc(UserData, Size);
+	FMemory::Memcpy(NewPtr, Ptr, OldSize);
+	return NewPtr;
+}
+
+void FFragmentTriangulator::ArenaFree(void* UserData, void* Ptr)
+{
+	// Everything is released at once with the arena
+}
+
+FFragmentVertexWelder::FFragmentVertexWelder(double InTolerance)
+	: Tolerance(FMath::Max(InTolerance, UE_DOUBLE_KINDA_SMALL_NUMBER))
+{
+}
+
+FIntVector FFragmentVertexWelder::GetCell(const FVector& Position) const
+{
+	return FIntVector(
+		FMath::FloorToInt32(Position.X / Tolerance),
+		FMath::FloorToInt32(Position.Y / Tolerance),
+		FMath::FloorToInt32(Position.Z / Tolerance));
+}
+
+int32 FFragmentVertexWelder::Find(const FVector& Position) const
+{
+	// Cells are as wide as the tolerance, so a match is at most one cell away
+	const FIntVector Cell = GetCell(Position);
+	const double ToleranceSquared = Tolerance * Tolerance;
+
+	for (int32 X = -1; X <= 1; X++)
+	{
+		for (int32 Y = -1; Y <= 1; Y++)
+		{
+			for (int32 Z = -1; Z <= 1; Z++)
+			{
+				const TArray<int32, TInlineAllocator<1>>* Entries = Cells.Find(Cell + FIntVector(X, Y, Z));
+				if (!Entries) continue;
+
+				for (const int32 Entry : *Entries)
+				{
+					if (FVector::DistSquared(Positions[Entry], Position) <= ToleranceSquared)
+					{
+						return Ids[Entry];
+					}
+				}
+			}
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FFragmentVertexWelder::Add(const FVector& Position, int32 Id)
+{
+	Cells.FindOrAdd(GetCell(Position)).Add(Positions.Num());
+	Positions.Add(Position);
+	Ids.Add(Id);
+}
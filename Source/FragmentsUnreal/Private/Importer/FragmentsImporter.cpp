@@ -14,9 +14,10 @@
 #include "GeometryScript/GeometryScriptTypes.h"
 #include "Curve/PolygonIntersectionUtils.h"
 #include "CompGeom/PolygonTriangulation.h"
-#include "tesselator.h"
+#include "Importer/FragmentTriangulator.h"
 #include "Algo/Reverse.h"
 #include "Fragment/Fragment.h"
+#include "Fragment/FragmentInstancedMeshComponent.h"
 #include "Importer/FragmentModelWrapper.h"
 #include "UObject/SavePackage.h"
 #include "Misc/ScopedSlowTask.h"
@@ -24,21 +25,110 @@
 #include "DynamicMesh/DynamicMesh3.h"
 #include "Materials/MaterialInterface.h"
 #include "DynamicMesh/MeshNormals.h"
+#include "DynamicMesh/DynamicMeshAttributeSet.h"
 #include "Components/DynamicMeshComponent.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/ParallelFor.h"
+#include "StaticMeshResources.h"
+#include "ConvexVolume.h"
+#include "Camera/CameraTypes.h"
+#include "Kismet/GameplayStatics.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "CompGeom/ConvexHull3.h"
 
 
 
 DEFINE_LOG_CATEGORY(LogFragments);
 
+namespace
+{
+	EFragmentSpawnMode ResolveSpawnMode(EFragmentSpawnMode SpawnMode, bool bUseDynamicMesh)
+	{
+		if (SpawnMode == EFragmentSpawnMode::Actors) return SpawnMode;
+
+		if (bUseDynamicMesh)
+		{
+			UE_LOG(LogFragments, Warning, TEXT("Instanced and DataOnly spawn modes need static meshes, falling back to one component per sample for dynamic meshes"));
+			return EFragmentSpawnMode::Actors;
+		}
+		return SpawnMode;
+	}
+
+	// Shapes for the BoundingBox and SimpleConvex collision modes, Points are the mesh vertices
+	FKAggregateGeom MakeSimpleCollision(EFragmentCollisionMode Mode, const TArray<FVector>& Points)
+	{
+		FKAggregateGeom AggGeom;
+		const FBox Box(Points);
+		if (!Box.IsValid) return AggGeom;
+
+		if (Mode == EFragmentCollisionMode::SimpleConvex)
+		{
+			// Flat meshes have no hull and fall back to their box
+			UE::Geometry::FConvexHull3d Hull;
+			if (Hull.Solve(Points) && Hull.GetDimension() == 3)
+			{
+				TSet<int32> HullVertices;
+				for (const UE::Geometry::FIndex3i& Triangle : Hull.GetTriangles())
+				{
+					HullVertices.Add(Triangle.A);
+					HullVertices.Add(Triangle.B);
+					HullVertices.Add(Triangle.C);
+				}
+
+				FKConvexElem& ConvexElem = AggGeom.ConvexElems.AddDefaulted_GetRef();
+				for (const int32 VertexIndex : HullVertices)
+				{
+					ConvexElem.VertexData.Add(Points[VertexIndex]);
+				}
+				ConvexElem.UpdateElemBox();
+				return AggGeom;
+			}
+		}
+
+		const FVector Size = Box.GetSize();
+		FKBoxElem& BoxElem = AggGeom.BoxElems.Emplace_GetRef(Size.X, Size.Y, Size.Z);
+		BoxElem.Center = Box.GetCenter();
+		return AggGeom;
+	}
+}
+
 UFragmentsImporter::UFragmentsImporter()
 {
 
 }
 
-FString UFragmentsImporter::Process(AActor* OwnerA, const FString& FragPath, TArray<AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh)
+void UFragmentsImporter::BeginDestroy()
+{
+	if (SpawnTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(SpawnTickerHandle);
+		SpawnTickerHandle.Reset();
+	}
+	SpawnTasks.Empty();
+
+	if (CollisionTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(CollisionTickerHandle);
+		CollisionTickerHandle.Reset();
+	}
+	PendingCollision.Empty();
+	CookingBodySetups.Empty();
+
+	Super::BeginDestroy();
+}
+
+FString UFragmentsImporter::Process(AActor* OwnerA, const FString& FragPath, TArray<AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, EFragmentMeshBuildPreset BuildPreset)
 {
 	SetOwnerRef(OwnerA);
-	FString ModelGuidStr = LoadFragment(FragPath);
+
+	FString ModelGuidStr;
+	{
+		// The model captures the settings when it loads
+		FFragmentMeshBuildSettings PresetSettings = MeshBuildSettings;
+		PresetSettings.ApplyPreset(BuildPreset);
+		TGuardValue<FFragmentMeshBuildSettings> SettingsGuard(MeshBuildSettings, PresetSettings);
+		ModelGuidStr = LoadFragment(FragPath);
+	}
 
 	if (ModelGuidStr.IsEmpty())	return FString();
 	
@@ -49,7 +139,8 @@ FString UFragmentsImporter::Process(AActor* OwnerA, const FString& FragPath, TAr
 	BaseMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentMaterial.M_BaseFragmentMaterial"));
 
 	FDateTime StartTime = FDateTime::Now();
-	SpawnFragmentModel(Wrapper->GetModelItem(), OwnerRef, ModelRef->meshes(), bSaveMeshes, Wrapper, bUseDynamicMesh);
+	BuildRepresentationMeshes(Wrapper, 0, ModelRef->meshes(), ModelGuidStr, bSaveMeshes, bUseDynamicMesh);
+	Wrapper->SetSpawnedFragment(SpawnFragmentModel(Wrapper->GetModelItem(), OwnerRef, ModelRef->meshes(), bSaveMeshes, Wrapper, bUseDynamicMesh, SpawnMode));
 	UE_LOG(LogFragments, Warning, TEXT("Loaded model in [%s]s -> %s"), *(FDateTime::Now() - StartTime).ToString(), *ModelGuidStr);
 	if (PackagesToSave.Num() > 0)
 	{
@@ -69,12 +160,12 @@ void UFragmentsImporter::GetItemData(AFragment*& InFragment)
 		UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InFragment->GetModelGuid());
 		const Model* InModel = Wrapper->GetParsedModel();
 		
-		int32 ItemIndex = UFragmentsUtils::GetIndexForLocalId(InModel, InFragment->GetLocalId());
+		int32 ItemIndex = Wrapper->GetIndexForLocalId(InFragment->GetLocalId());
 		if (ItemIndex == INDEX_NONE) return;
 	
 		// Attributes
-		const auto* attribute = InModel->attributes()->Get(ItemIndex);
-		TArray<FItemAttribute> ItemAttributes = UFragmentsUtils::ParseItemAttribute(attribute);
+		TArray<FItemAttribute> ItemAttributes;
+		Wrapper->GetAttributeTable().GetItemAttributes(ItemIndex, ItemAttributes);
 		InFragment->SetAttributes(ItemAttributes);
 
 		// Category
@@ -94,47 +185,48 @@ void UFragmentsImporter::GetItemData(AFragment*& InFragment)
 
 void UFragmentsImporter::GetItemData(FFragmentItem* InFragmentItem)
 {
-	if (InFragmentItem->ModelGuid.IsEmpty()) return;
+	if (!InFragmentItem || InFragmentItem->ModelGuid.IsEmpty()) return;
 
 	if (FragmentModels.Contains(InFragmentItem->ModelGuid))
 	{
 		UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InFragmentItem->ModelGuid);
-		const Model* InModel = Wrapper->GetParsedModel();
+		FillItemData(Wrapper, InFragmentItem);
+	}
+}
 
-		int32 ItemIndex = UFragmentsUtils::GetIndexForLocalId(InModel, InFragmentItem->LocalId);
-		flatbuffers::uoffset_t ii = ItemIndex;
-		if (ItemIndex == INDEX_NONE) return;
+void UFragmentsImporter::FillItemData(const UFragmentModelWrapper* Wrapper, FFragmentItem* InFragmentItem)
+{
+	const Model* InModel = Wrapper ? Wrapper->GetParsedModel() : nullptr;
+	if (!InModel || !InFragmentItem) return;
 
-		// Attributes
-		if (ii < InModel->attributes()->size())
-		{
-			const auto* attribute = InModel->attributes()->Get(ItemIndex);
-			TArray<FItemAttribute> ItemAttributes = UFragmentsUtils::ParseItemAttribute(attribute);
-			InFragmentItem->Attributes = ItemAttributes;
-		}
+	int32 ItemIndex = Wrapper->GetIndexForLocalId(InFragmentItem->LocalId);
+	flatbuffers::uoffset_t ii = ItemIndex;
+	if (ItemIndex == INDEX_NONE) return;
 
-		// Category
-		if (ii < InModel->categories()->size())
+	// Attributes
+	Wrapper->GetAttributeTable().GetItemAttributes(ItemIndex, InFragmentItem->Attributes);
+
+	// Category
+	if (ii < InModel->categories()->size())
+	{
+		const auto* category = InModel->categories()->Get(ItemIndex);
+		if (category)  // Null check for category
 		{
-			const auto* category = InModel->categories()->Get(ItemIndex);
-			if (category)  // Null check for category
-			{
-				const char* RawCategory = category->c_str();
-				FString CategorySty = UTF8_TO_TCHAR(RawCategory);
-				InFragmentItem->Category = CategorySty;
-			}
+			const char* RawCategory = category->c_str();
+			FString CategorySty = UTF8_TO_TCHAR(RawCategory);
+			InFragmentItem->Category = CategorySty;
 		}
+	}
 
-		// Guids
-		if (ii < InModel->guids()->size())
+	// Guids
+	if (ii < InModel->guids()->size())
+	{
+		const auto* item_guid = InModel->guids()->Get(ItemIndex);
+		if (item_guid)  
 		{
-			const auto* item_guid = InModel->guids()->Get(ItemIndex);
-			if (item_guid)  
-			{
-				const char* RawGuid = item_guid->c_str();
-				FString GuidStr = UTF8_TO_TCHAR(RawGuid);
-				InFragmentItem->Guid = GuidStr;
-			}
+			const char* RawGuid = item_guid->c_str();
+			FString GuidStr = UTF8_TO_TCHAR(RawGuid);
+			InFragmentItem->Guid = GuidStr;
 		}
 	}
 }
@@ -150,9 +242,9 @@ TArray<FItemAttribute> UFragmentsImporter::GetItemPropertySets(AFragment* InFrag
 	if (!InModel) return CollectedAttributes;
 
 	TSet<int32> Visited;
-	CollectPropertiesRecursive(InModel, InFragment->GetLocalId(), Visited, CollectedAttributes);
-	return UFragmentsUtils::ParsePropertySets(CollectedAttributes);
-	//return CollectedAttributes;
+	TArray<int32> CollectedRows;
+	CollectPropertiesRecursive(Wrapper, InFragment->GetLocalId(), Visited, CollectedRows);
+	return Wrapper->GetAttributeTable().GetPropertySets(CollectedRows);
 }
 
 TArray<FItemAttribute> UFragmentsImporter::GetItemPropertySets(FFragmentItem* InFragment)
@@ -166,9 +258,9 @@ TArray<FItemAttribute> UFragmentsImporter::GetItemPropertySets(FFragmentItem* In
 	if (!InModel) return CollectedAttributes;
 
 	TSet<int32> Visited;
-	CollectPropertiesRecursive(InModel, InFragment->LocalId, Visited, CollectedAttributes);
-	return UFragmentsUtils::ParsePropertySets(CollectedAttributes);
-	//return CollectedAttributes;
+	TArray<int32> CollectedRows;
+	CollectPropertiesRecursive(Wrapper, InFragment->LocalId, Visited, CollectedRows);
+	return Wrapper->GetAttributeTable().GetPropertySets(CollectedRows);
 }
 
 TArray<FItemAttribute> UFragmentsImporter::GetItemPropertySets(int32 LocalId, const FString& InModelGuid)
@@ -182,24 +274,61 @@ TArray<FItemAttribute> UFragmentsImporter::GetItemPropertySets(int32 LocalId, co
 	if (!InModel) return CollectedAttributes;
 
 	TSet<int32> Visited;
-	CollectPropertiesRecursive(InModel, LocalId, Visited, CollectedAttributes);
-	return UFragmentsUtils::ParsePropertySets(CollectedAttributes);
-	//return CollectedAttributes;
+	TArray<int32> CollectedRows;
+	CollectPropertiesRecursive(Wrapper, LocalId, Visited, CollectedRows);
+	return Wrapper->GetAttributeTable().GetPropertySets(CollectedRows);
 }
 
+TArray<int32> UFragmentsImporter::GetRelatedItems(int32 LocalId, const FString& InModelGuid, const FString& RelationName)
+{
+	TArray<int32> RelatedLocalIds;
+	if (UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(InModelGuid))
+	{
+		(*WrapperPtr)->GetRelationIndex().GetRelated(LocalId, RelationName, RelatedLocalIds);
+	}
+	return RelatedLocalIds;
+}
 
 AFragment* UFragmentsImporter::GetItemByLocalId(int32 LocalId, const FString& ModelGuid)
 {
-	if (ModelFragmentsMap.Contains(ModelGuid))
+	if (FFragmentLookup* Lookup = ModelFragmentsMap.Find(ModelGuid))
 	{
-		FFragmentLookup Lookup = *ModelFragmentsMap.Find(ModelGuid);
-
-		if (Lookup.Fragments.Contains(LocalId))
+		if (AFragment** Found = Lookup->Fragments.Find(LocalId))
 		{
-			return *Lookup.Fragments.Find(LocalId);
+			return *Found;
 		}
 	}
-	return nullptr;
+
+	// Items of a DataOnly model have no actor until somebody asks for one
+	return SpawnDataOnlyItem(LocalId, ModelGuid);
+}
+
+AFragment* UFragmentsImporter::SpawnDataOnlyItem(int32 LocalId, const FString& ModelGuid)
+{
+	UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid);
+	if (!WrapperPtr || !(*WrapperPtr)->IsDataOnly()) return nullptr;
+
+	AFragment* RootFragment = (*WrapperPtr)->GetSpawnedFragment();
+	if (!RootFragment) return nullptr;
+
+	const TArray<FFragmentItem>& Items = (*WrapperPtr)->GetItems();
+	const int32 ItemIndex = (*WrapperPtr)->FindItemSlot(LocalId);
+	if (ItemIndex == INDEX_NONE) return nullptr;
+
+	// Same relative transform the attachment chain of the Actors mode would produce
+	FTransform ItemToRoot = FTransform::Identity;
+	int32 Index = ItemIndex;
+	while (Index != INDEX_NONE && Items[Index].LocalId != RootFragment->GetLocalId())
+	{
+		ItemToRoot = ItemToRoot * Items[Index].GlobalTransform;
+		Index = Items[Index].ParentIndex;
+	}
+
+	// Not part of the spawned subtree
+	if (Index == INDEX_NONE) return nullptr;
+
+	// The geometry is already drawn by the root's instanced components, the actor only carries the data
+	return SpawnFragmentActor(Items[ItemIndex], RootFragment, ItemToRoot);
 }
 
 FFragmentItem* UFragmentsImporter::GetFragmentItemByLocalId(int32 LocalId, const FString& InModelGuid)
@@ -207,96 +336,117 @@ FFragmentItem* UFragmentsImporter::GetFragmentItemByLocalId(int32 LocalId, const
 	if (FragmentModels.Contains(InModelGuid))
 	{
 		UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InModelGuid);
-		FFragmentItem* FoundItem;
-		if (Wrapper->GetModelItem().FindFragmentByLocalId(LocalId, FoundItem))
-		{
-			return FoundItem;
-		}
+		return Wrapper->FindItem(LocalId);
 	}
 	return nullptr;
 }
 
 FString UFragmentsImporter::LoadFragment(const FString& FragPath)
 {
-	TArray<uint8> CompressedData;
-	bool bIsCompressed = false;
-	TArray<uint8> Decompressed;
-
-
-	if (!FFileHelper::LoadFileToArray(CompressedData, *FragPath))
+	UFragmentModelWrapper* Wrapper = NewObject<UFragmentModelWrapper>(this);
+	Wrapper->SetMeshBuildSettings(MeshBuildSettings);
+	Wrapper->GetGeometryCache().SetFilePath(GetGeometryCachePath(FragPath));
+	Wrapper->GetGeometryCache().SetSettingsHash(MeshBuildSettings.GetSettingsHash());
+	if (!BuildModelData(FragPath, Wrapper, nullptr))
 	{
-		UE_LOG(LogFragments, Error, TEXT("Failed to load the compressed file"));
 		return FString();
 	}
 
-	if (CompressedData.Num() >= 2 && CompressedData[0] == 0x78)
-	{
-		bIsCompressed = true;
-		UE_LOG(LogFragments, Log, TEXT("Zlib header detected. Starting decompression..."));
-	}
+	return RegisterLoadedModel(Wrapper);
+}
 
-	if (bIsCompressed)
-	{
-		// Use zlib directly (Unreal's zlib.h)
-		z_stream stream = {};
-		stream.next_in = CompressedData.GetData();
-		stream.avail_in = CompressedData.Num();
+int32 UFragmentsImporter::LoadFragmentAsync(const FString& FragPath, TFunction<void(int32, float)> OnProgress, TFunction<void(int32, const FString&)> OnCompleted)
+{
+	TSharedRef<FFragmentLoadRequest> Request = MakeShared<FFragmentLoadRequest>();
+	Request->RequestId = ++LastLoadRequestId;
+	Request->OnProgress = MoveTemp(OnProgress);
+	LoadRequests.Add(Request->RequestId, Request);
+
+	// The wrapper is filled on the worker, keep it alive until it is registered on the game thread
+	UFragmentModelWrapper* Wrapper = NewObject<UFragmentModelWrapper>(this);
+	Wrapper->SetMeshBuildSettings(MeshBuildSettings);
+	Wrapper->GetGeometryCache().SetFilePath(GetGeometryCachePath(FragPath));
+	Wrapper->GetGeometryCache().SetSettingsHash(MeshBuildSettings.GetSettingsHash());
+	Wrapper->AddToRoot();
 
-		int32 ret = inflateInit(&stream);
-		if (ret != Z_OK)
+	TWeakObjectPtr<UFragmentsImporter> WeakThis(this);
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Wrapper, Request, FragPath, OnCompleted]()
 		{
-			UE_LOG(LogFragments, Error, TEXT("zlib initialization failed: %d"), ret);
-			return FString();
-		}
+			const bool bLoaded = BuildModelData(FragPath, Wrapper, &Request.Get());
 
-		const int32 ChunkSize = 1024 * 1024;
-		int32 TotalOut = 0;
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Wrapper, Request, bLoaded, OnCompleted]()
+				{
+					Wrapper->RemoveFromRoot();
 
-		for (int32 i = 0; i < 100; ++i)
-		{
-			int32 OldSize = Decompressed.Num();
-			Decompressed.AddUninitialized(ChunkSize);
-			stream.next_out = Decompressed.GetData() + OldSize;
-			stream.avail_out = ChunkSize;
+					FString ModelGuid;
+					if (UFragmentsImporter* Importer = WeakThis.Get())
+					{
+						Importer->LoadRequests.Remove(Request->RequestId);
+						if (bLoaded && !Request->IsCancelled())
+						{
+							ModelGuid = Importer->RegisterLoadedModel(Wrapper);
+						}
+					}
 
-			ret = inflate(&stream, Z_NO_FLUSH);
+					if (Request->IsCancelled())
+					{
+						UE_LOG(LogFragments, Log, TEXT("Fragment load request %d was cancelled"), Request->RequestId);
+					}
 
-			if (ret == Z_STREAM_END)
-			{
-				TotalOut = OldSize + ChunkSize - stream.avail_out;
-				break;
-			}
-			else if (ret != Z_OK)
-			{
-				UE_LOG(LogFragments, Error, TEXT("Decompression failed with error code: %d"), ret);
-				break;
-			}
-		}
+					if (OnCompleted)
+					{
+						OnCompleted(Request->RequestId, ModelGuid);
+					}
+				});
+		});
 
-		ret = inflateEnd(&stream);
-		if (ret != Z_OK)
-		{
-			UE_LOG(LogFragments, Error, TEXT("zlib end stream failed: %d"), ret);
-			return FString();
-		}
+	return Request->RequestId;
+}
 
-		Decompressed.SetNum(TotalOut);
-		//UE_LOG(LogFragments, Log, TEXT("Decompression complete. Total bytes: %d"), TotalOut);
+void UFragmentsImporter::CancelLoadFragment(int32 RequestId)
+{
+	if (TSharedPtr<FFragmentLoadRequest>* Request = LoadRequests.Find(RequestId))
+	{
+		(*Request)->Cancel();
 	}
-	else
+}
+
+void FFragmentLoadRequest::SetProgress(float InProgress)
+{
+	// Throttle the game thread notifications to whole percents
+	if (!OnProgress || InProgress - LastReportedProgress < 0.01f) return;
+	LastReportedProgress = InProgress;
+
+	TWeakPtr<FFragmentLoadRequest> WeakRequest = AsShared();
+	AsyncTask(ENamedThreads::GameThread, [WeakRequest, InProgress]()
+		{
+			TSharedPtr<FFragmentLoadRequest> Request = WeakRequest.Pin();
+			if (Request && Request->OnProgress && !Request->IsCancelled())
+			{
+				Request->OnProgress(Request->RequestId, InProgress);
+			}
+		});
+}
+
+bool UFragmentsImporter::BuildModelData(const FString& FragPath, UFragmentModelWrapper* Wrapper, FFragmentLoadRequest* Request)
+{
+	// Runs on a worker thread for async loads: only fill the wrapper, never create or look up UObjects here
+	if (!LoadModelBuffer(FragPath, Wrapper, Request))
 	{
-		Decompressed = CompressedData;
-		UE_LOG(LogFragments, Log, TEXT("Data appears uncompressed, using raw data"));
+		return false;
 	}
 
-	UFragmentModelWrapper* Wrapper = NewObject<UFragmentModelWrapper>(this);
-	Wrapper->LoadModel(Decompressed);
 	const Model* ModelRef = Wrapper->GetParsedModel();
 
 	if (!ModelRef)
 	{
 		UE_LOG(LogFragments, Error, TEXT("Failed to parse Fragments model"));
-		return FString();
+		return false;
+	}
+
+	if (Wrapper->GetGeometryCache().Load())
+	{
+		UE_LOG(LogFragments, Log, TEXT("Loaded %d cached meshes from %s"), Wrapper->GetGeometryCache().Num(), *Wrapper->GetGeometryCache().GetFilePath());
 	}
 
 	const auto* guid = ModelRef->guid();
@@ -308,41 +458,37 @@ FString UFragmentsImporter::LoadFragment(const FString& FragPath)
 
 	const auto* spatial_structure = ModelRef->spatial_structure();
 	FTransform RootTransform =  UFragmentsUtils::MakeTransform(_meshes->coordinates());
-	FVector RootOffset = FVector::ZeroVector;
-	if (!bBaseCoordinatesInitialized)
-	{
-		BaseCoordinates = RootTransform;
-		bBaseCoordinatesInitialized = true;
-	}
-	else
-	{
-		RootOffset = BaseCoordinates.GetLocation() - RootTransform.GetLocation();
-	}
 
-	//FTransform RootTransform =  FTransform::Identity;
-	FFragmentItem FragmentItem;
+	TArray<FFragmentItem> Items;
+	FFragmentItem& FragmentItem = Items.AddDefaulted_GetRef();
 	FragmentItem.Guid = ModelGuidStr;
 	FragmentItem.ModelGuid = ModelGuidStr;
 	FragmentItem.GlobalTransform = RootTransform;
-	UFragmentsUtils::MapModelStructureToData(spatial_structure, FragmentItem, TEXT(""));
-
-	Wrapper->SetModelItem(FragmentItem);
-	FragmentModels.Add(ModelGuidStr, Wrapper);
+	UFragmentsUtils::MapModelStructureToData(spatial_structure, Items, 0, TEXT(""));
+	Wrapper->SetItems(MoveTemp(Items));
 
+	if (Request)
+	{
+		if (Request->IsCancelled()) return false;
+		Request->SetProgress(0.7f);
+	}
 
-	// Loop through samples and spawn meshes
+	// Group samples per item. Global transforms are stored relative to this model,
+	// the offset to the shared base coordinates is applied when the model is registered.
 	if (_meshes)
 	{
 		const auto* samples = _meshes->samples();
-		const auto* representations = _meshes->representations();
-		const auto* coordinates = _meshes->coordinates();
 		const auto* meshes_items = _meshes->meshes_items();
-		const auto* materials = _meshes->materials();
-		const auto* cirle_extrusions = _meshes->circle_extrusions();
-		const auto* shells = _meshes->shells();
-		const auto* local_tranforms = _meshes->local_transforms();
 		const auto* global_transforms = _meshes->global_transforms();
 
+		// Geometry hashes are computed once per representation and carried by every sample using it.
+		// They include the build settings, so models built differently don't share meshes.
+		const auto* representations = _meshes->representations();
+		const uint32 SettingsHash = Wrapper->GetMeshBuildSettings().GetSettingsHash();
+		TArray<uint64> RepresentationHashes;
+		TBitArray<> RepresentationHashed(false, representations ? representations->size() : 0);
+		RepresentationHashes.SetNumZeroed(RepresentationHashed.Num());
+
 		// Grouping samples by Item ID
 		TMap<int32, TArray<const Sample*>> SamplesByItem;
 		for (flatbuffers::uoffset_t i = 0; i < samples->size(); i++)
@@ -351,34 +497,30 @@ FString UFragmentsImporter::LoadFragment(const FString& FragPath)
 			SamplesByItem.FindOrAdd(sample->item()).Add(sample);
 		}
 
+		int32 ProcessedItems = 0;
 		for (const auto& Item : SamplesByItem)
 		{
 			int32 ItemId = Item.Key;
 
-			const TArray<const Sample*> ItemSamples = Item.Value;
+			const TArray<const Sample*>& ItemSamples = Item.Value;
 
 			const auto mesh = meshes_items->Get(ItemId);
 			const auto local_id = local_ids->Get(ItemId);
 
-			FFragmentItem* FoundFragmentItem = nullptr;
-			if (!Wrapper->GetModelItem().FindFragmentByLocalId(local_id, FoundFragmentItem))
+			FFragmentItem* FoundFragmentItem = Wrapper->FindItem(local_id);
+			if (!FoundFragmentItem)
 			{
-				return FString();
+				return false;
 			}
 
-			GetItemData(FoundFragmentItem);
+			FillItemData(Wrapper, FoundFragmentItem);
 
 			const auto* global_transform = global_transforms->Get(mesh);
-			FTransform GlobalTransform = UFragmentsUtils::MakeTransform(global_transform);
-			GlobalTransform.AddToTranslation(2*RootOffset);
-			FoundFragmentItem->GlobalTransform = GlobalTransform;
+			FoundFragmentItem->GlobalTransform = UFragmentsUtils::MakeTransform(global_transform);
 
 			for (int32 i = 0; i < ItemSamples.Num(); i++)
 			{
 				const Sample* sample = ItemSamples[i];
-				const auto* material = materials->Get(sample->material());
-				const auto* representation = representations->Get(sample->representation());
-				const auto* local_transform = local_tranforms->Get(sample->local_transform());
 
 				FFragmentSample SampleInfo;
 				SampleInfo.SampleIndex = i;
@@ -386,185 +528,1093 @@ FString UFragmentsImporter::LoadFragment(const FString& FragPath)
 				SampleInfo.RepresentationIndex = sample->representation();
 				SampleInfo.MaterialIndex = sample->material();
 
+				if (RepresentationHashed.IsValidIndex(SampleInfo.RepresentationIndex))
+				{
+					if (!RepresentationHashed[SampleInfo.RepresentationIndex])
+					{
+						RepresentationHashes[SampleInfo.RepresentationIndex] = UFragmentsUtils::HashRepresentationGeometry(_meshes, representations->Get(SampleInfo.RepresentationIndex), SettingsHash);
+						RepresentationHashed[SampleInfo.RepresentationIndex] = true;
+					}
+					SampleInfo.GeometryHash = RepresentationHashes[SampleInfo.RepresentationIndex];
+				}
+
 				FoundFragmentItem->Samples.Add(SampleInfo);
 			}
 
+			if (Request && (++ProcessedItems % 1024) == 0)
+			{
+				if (Request->IsCancelled()) return false;
+				Request->SetProgress(0.7f + 0.3f * ProcessedItems / SamplesByItem.Num());
+			}
 		}
 	}
-	ModelFragmentsMap.Add(ModelGuidStr, FFragmentLookup());
 
-	return ModelGuidStr;
+	Wrapper->BuildSpatialIndex();
+
+	if (Request)
+	{
+		if (Request->IsCancelled()) return false;
+		Request->SetProgress(1.0f);
+	}
+
+	return true;
 }
 
-void UFragmentsImporter::ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh)
+FString UFragmentsImporter::RegisterLoadedModel(UFragmentModelWrapper* Wrapper)
 {
-	if (!InOwnerRef || !FragmentModels.Contains(InModelGuid)) return;
+	TArray<FFragmentItem>& Items = Wrapper->GetItems();
+	if (Items.Num() == 0) return FString();
 
-	SetOwnerRef(InOwnerRef);
+	const FString ModelGuidStr = Items[0].ModelGuid;
 
-	UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InModelGuid);
-	const Model* ModelRef = Wrapper->GetParsedModel();
+	FTransform RootTransform = Items[0].GlobalTransform;
+	FVector RootOffset = FVector::ZeroVector;
+	if (!bBaseCoordinatesInitialized)
+	{
+		BaseCoordinates = RootTransform;
+		bBaseCoordinatesInitialized = true;
+	}
+	else
+	{
+		RootOffset = BaseCoordinates.GetLocation() - RootTransform.GetLocation();
+	}
 
-	BaseGlassMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentGlassMaterial.M_BaseFragmentGlassMaterial"));
-	BaseMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentMaterial.M_BaseFragmentMaterial"));
-	
-	FDateTime StartTime = FDateTime::Now();
-	Wrapper->SetSpawnedFragment(SpawnFragmentModel(Wrapper->GetModelItem(), OwnerRef, ModelRef->meshes(), bInSaveMesh, Wrapper, bUseDynamicMesh));
-	UE_LOG(LogFragments, Warning, TEXT("Loaded model in [%s]s -> %s"), *(FDateTime::Now() - StartTime).ToString(), *InModelGuid);
-	if (PackagesToSave.Num() > 0)
+	// Items with geometry are placed relative to the first loaded model
+	if (!RootOffset.IsZero())
 	{
-		DeferredSaveManager.AddPackagesToSave(PackagesToSave);
-		PackagesToSave.Empty();
+		for (int32 ItemIndex = 1; ItemIndex < Items.Num(); ItemIndex++)
+		{
+			if (Items[ItemIndex].Samples.Num() > 0)
+			{
+				Items[ItemIndex].GlobalTransform.AddToTranslation(2 * RootOffset);
+			}
+		}
 	}
-}
 
-void UFragmentsImporter::ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh)
-{
-	FFragmentItem* Item = GetFragmentItemByLocalId(InLocalId, InModelGuid);
+	// Spatial structure items between the root and the ones with geometry keep an identity transform,
+	// so in model space the offset is the same translation for every sample
+	Wrapper->SetSpatialOffset(RootTransform.TransformVector(2 * RootOffset));
 
-	if (!InOwnerRef || !Item) return;
+	FragmentModels.Add(ModelGuidStr, Wrapper);
+	ModelFragmentsMap.Add(ModelGuidStr, FFragmentLookup());
 
-	SetOwnerRef(InOwnerRef);
+	return ModelGuidStr;
+}
 
-	UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InModelGuid);
-	const Model* ModelRef = Wrapper->GetParsedModel();
+FTransform UFragmentsImporter::GetModelToWorld(UFragmentModelWrapper* Wrapper) const
+{
+	const FTransform SpatialToModel(Wrapper->GetSpatialOffset());
+	AFragment* SpawnedFragment = Wrapper->GetSpawnedFragment();
+	if (!IsValid(SpawnedFragment)) return SpatialToModel;
 
-	BaseGlassMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentGlassMaterial.M_BaseFragmentGlassMaterial"));
-	BaseMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentMaterial.M_BaseFragmentMaterial"));
+	// The spawned actor was placed at its item's model transform, and follows it if it is moved afterwards
+	const FTransform ItemToModel = Wrapper->GetItemToModel(Wrapper->GetSpawnedItemSlot());
+	return SpatialToModel * ItemToModel.Inverse() * SpawnedFragment->GetActorTransform();
+}
 
-	FDateTime StartTime = FDateTime::Now();
-	Wrapper->SetSpawnedFragment(SpawnFragmentModel(*Item, OwnerRef, ModelRef->meshes(), bInSaveMesh, Wrapper, bUseDynamicMesh));
-	UE_LOG(LogFragments, Warning, TEXT("Loaded model in [%s]s -> %s"), *(FDateTime::Now() - StartTime).ToString(), *InModelGuid);
-	if (PackagesToSave.Num() > 0)
+const FFragmentMeshBuildSettings& UFragmentsImporter::GetModelMeshBuildSettings(const FString& ModelGuid) const
+{
+	if (UFragmentModelWrapper* const* Wrapper = FragmentModels.Find(ModelGuid))
 	{
-		DeferredSaveManager.AddPackagesToSave(PackagesToSave);
-		PackagesToSave.Empty();
+		return (*Wrapper)->GetMeshBuildSettings();
 	}
+	return MeshBuildSettings;
 }
 
-TArray<int32> UFragmentsImporter::GetElementsByCategory(const FString& InCategory, const FString& ModelGuid)
+FString UFragmentsImporter::GetGeometryCachePath(const FString& FragPath) const
 {
-	TArray<int32> LocalIds;
+	if (!bUseGeometryCache) return FString();
 
-	if (FragmentModels.Contains(ModelGuid))
+	if (GeometryCacheDirectory.IsEmpty())
 	{
-		UFragmentModelWrapper* Wrapper = *FragmentModels.Find(ModelGuid);
-		const Model* InModel = Wrapper->GetParsedModel();
-
-		if (!InModel)
-			return LocalIds;
+		return FPaths::ChangeExtension(FragPath, TEXT("fragcache"));
+	}
 
-		const auto* categories = InModel->categories();
-		const auto* local_ids = InModel->local_ids();
+	// Files from different folders may share a name
+	const uint32 PathHash = FCrc::StrCrc32(*FPaths::ConvertRelativePathToFull(FragPath));
+	return GeometryCacheDirectory / FString::Printf(TEXT("%s_%08x.fragcache"), *FPaths::GetBaseFilename(FragPath), PathHash);
+}
 
-		if (!categories || !local_ids)
-			return LocalIds;
+bool UFragmentsImporter::LoadModelBuffer(const FString& FragPath, UFragmentModelWrapper* Wrapper, FFragmentLoadRequest* Request)
+{
+	if (!Wrapper) return false;
 
-		for (flatbuffers::uoffset_t i = 0; i < categories->size(); i++)
+	// Uncompressed files are parsed in place from a memory mapping, so the model is never copied
+	bool bIsCompressed = true;
+	{
+		TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FragPath));
+		uint8 Header[2] = { 0, 0 };
+		if (FileHandle && FileHandle->Size() >= 2 && FileHandle->Read(Header, 2))
 		{
-			const auto* category = categories->Get(i);
-			FString CategoryName = UTF8_TO_TCHAR(category->c_str());
-
-			if (CategoryName.Equals(InCategory, ESearchCase::IgnoreCase))
-			{
-				int32 LocalId = local_ids->Get(i);
-				LocalIds.Add(LocalId);
-			}
+			bIsCompressed = Header[0] == 0x78 || (Header[0] == 0x1f && Header[1] == 0x8b);
 		}
 	}
-	return LocalIds;
-}
 
-void UFragmentsImporter::UnloadFragment(const FString& ModelGuid)
-{
-	if (FFragmentLookup* Lookup = ModelFragmentsMap.Find(ModelGuid))
+	if (!bIsCompressed && Wrapper->LoadMappedModel(FragPath))
 	{
-		for (TPair<int32, AFragment*> Obj : Lookup->Fragments)
+		UE_LOG(LogFragments, Log, TEXT("Data appears uncompressed, mapped %lld bytes"), Wrapper->GetBufferSize());
+	}
+	else
+	{
+		TArray<uint8> Buffer;
+		if (!ReadFragmentFile(FragPath, Buffer, Request))
 		{
-			Obj.Value->Destroy();
+			return false;
 		}
-		ModelFragmentsMap.Remove(ModelGuid);
+
+		Wrapper->LoadModel(MoveTemp(Buffer));
 	}
 
-	if (UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid))
+	if (Request)
 	{
-		UFragmentModelWrapper* Wrapper = *WrapperPtr;
-
-		Wrapper = nullptr;
-		FragmentModels.Remove(ModelGuid);
+		Request->SetProgress(0.6f);
 	}
+	return true;
 }
 
-AFragment* UFragmentsImporter::GetModelFragment(const FString& ModelGuid)
+bool UFragmentsImporter::ReadFragmentFile(const FString& FragPath, TArray<uint8>& OutBuffer, FFragmentLoadRequest* Request)
 {
-	if (FragmentModels.Contains(ModelGuid))
+	TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FragPath));
+	if (!FileHandle)
 	{
-		UFragmentModelWrapper* Wrapper = *FragmentModels.Find(ModelGuid);
-		return Wrapper->GetSpawnedFragment();
+		UE_LOG(LogFragments, Error, TEXT("Failed to load the compressed file"));
+		return false;
 	}
-	return nullptr;
-}
-
-void UFragmentsImporter::CollectPropertiesRecursive(
-	const Model* InModel,
-	int32 StartLocalId,
-	TSet<int32>& Visited,
-	TArray<FItemAttribute>& OutAttributes)
-{
-	if (!InModel || Visited.Contains(StartLocalId)) return;
-	Visited.Add(StartLocalId);
-
-	const auto* relations = InModel->relations();
-	const auto* attributes = InModel->attributes();
-	const auto* relations_items = InModel->relations_items();
 
-	for (flatbuffers::uoffset_t i = 0; i < relations_items->size(); i++)
+	const int64 FileSize = FileHandle->Size();
+	if (FileSize > MAX_int32)
 	{
-		if (relations_items->Get(i) != StartLocalId) continue;
-
-		const auto* Relation = relations->Get(i);
-		if (!Relation || !Relation->data()) continue;
+		UE_LOG(LogFragments, Error, TEXT("Fragment file is too large to be loaded: %lld bytes"), FileSize);
+		return false;
+	}
 
-		for (flatbuffers::uoffset_t j = 0; j < Relation->data()->size(); j++)
-		{
-			const char* RawStr = Relation->data()->Get(j)->c_str();
-			FString Cleaned = UTF8_TO_TCHAR(RawStr);
+	uint8 Header[2] = { 0, 0 };
+	if (FileSize >= 2 && FileHandle->Read(Header, 2))
+	{
+		FileHandle->Seek(0);
+	}
 
-			TArray<FString> Tokens;
-			Cleaned.Replace(TEXT("["), TEXT(""))
-				.Replace(TEXT("]"), TEXT(""))
-				.ParseIntoArray(Tokens, TEXT(","), true);
+	const bool bIsZlib = Header[0] == 0x78;
+	const bool bIsGzip = Header[0] == 0x1f && Header[1] == 0x8b;
 
-			if (Tokens.Num() < 2) continue;
+	OutBuffer.Reset();
 
-			FString RelationName = Tokens[0].TrimStartAndEnd().Replace(TEXT("\""), TEXT(""));
+	if (!bIsZlib && !bIsGzip)
+	{
+		UE_LOG(LogFragments, Log, TEXT("Data appears uncompressed, using raw data"));
+		OutBuffer.SetNumUninitialized(FileSize);
+		if (!FileHandle->Read(OutBuffer.GetData(), FileSize))
+		{
+			UE_LOG(LogFragments, Error, TEXT("Failed to read fragment file: %s"), *FragPath);
+			OutBuffer.Empty();
+			return false;
+		}
+		return true;
+	}
 
-			// Only allow property-related relations
-			if (!(RelationName.Equals(TEXT("IsDefinedBy")) || RelationName.Equals(TEXT("HasProperties")) || RelationName.Equals(TEXT("DefinesType"))))
-				continue;
+	UE_LOG(LogFragments, Log, TEXT("Zlib header detected. Starting decompression..."));
+
+	// Size hint for the output buffer. Gzip streams store the uncompressed size (mod 2^32) in the
+	// last four bytes; plain zlib streams carry no size, so start from a typical ratio for .frag files.
+	int64 EstimatedSize = FileSize * 4;
+	if (bIsGzip && FileSize >= 18)
+	{
+		uint8 Trailer[4];
+		FileHandle->Seek(FileSize - 4);
+		if (FileHandle->Read(Trailer, 4))
+		{
+			const int64 TrailerSize = Trailer[0] | (Trailer[1] << 8) | (Trailer[2] << 16) | ((int64)Trailer[3] << 24);
+			if (TrailerSize >= FileSize)
+			{
+				EstimatedSize = TrailerSize;
+			}
+		}
+		FileHandle->Seek(0);
+	}
+
+	// Use zlib directly (Unreal's zlib.h). 15 + 32 lets zlib detect zlib or gzip headers.
+	z_stream Stream = {};
+	int32 Ret = inflateInit2(&Stream, 15 + 32);
+	if (Ret != Z_OK)
+	{
+		UE_LOG(LogFragments, Error, TEXT("zlib initialization failed: %d"), Ret);
+		return false;
+	}
+
+	// The compressed file is streamed in fixed chunks, so only one chunk of it is ever held in memory
+	// next to the decompressed model. The output grows geometrically and inflate writes straight into its slack.
+	const int64 ChunkSize = 1024 * 1024;
+	TArray<uint8> InChunk;
+	InChunk.SetNumUninitialized(ChunkSize);
+	OutBuffer.Reserve(FMath::Clamp<int64>(EstimatedSize, ChunkSize, MAX_int32));
+
+	int64 RemainingIn = FileSize;
+	bool bSuccess = true;
+	while (Ret != Z_STREAM_END)
+	{
+		if (Stream.avail_in == 0)
+		{
+			if (RemainingIn == 0)
+			{
+				UE_LOG(LogFragments, Error, TEXT("Decompression failed: unexpected end of file"));
+				bSuccess = false;
+				break;
+			}
+
+			const int64 ToRead = FMath::Min(ChunkSize, RemainingIn);
+			if (!FileHandle->Read(InChunk.GetData(), ToRead))
+			{
+				UE_LOG(LogFragments, Error, TEXT("Failed to read fragment file: %s"), *FragPath);
+				bSuccess = false;
+				break;
+			}
+			RemainingIn -= ToRead;
+			Stream.next_in = InChunk.GetData();
+			Stream.avail_in = (uInt)ToRead;
+
+			if (Request)
+			{
+				if (Request->IsCancelled())
+				{
+					bSuccess = false;
+					break;
+				}
+				Request->SetProgress(0.6f * (FileSize - RemainingIn) / FileSize);
+			}
+		}
+
+		if (OutBuffer.GetSlack() < ChunkSize / 4)
+		{
+			const int64 NewMax = FMath::Min<int64>((int64)OutBuffer.Max() + FMath::Max<int64>(OutBuffer.Max() / 2, ChunkSize), MAX_int32);
+			if (NewMax <= OutBuffer.Max())
+			{
+				UE_LOG(LogFragments, Error, TEXT("Decompressed model exceeds the maximum supported size"));
+				bSuccess = false;
+				break;
+			}
+			OutBuffer.Reserve(NewMax);
+		}
+
+		const int32 Slack = OutBuffer.GetSlack();
+		Stream.next_out = OutBuffer.GetData() + OutBuffer.Num();
+		Stream.avail_out = Slack;
+
+		Ret = inflate(&Stream, Z_NO_FLUSH);
+		if (Ret != Z_OK && Ret != Z_STREAM_END)
+		{
+			UE_LOG(LogFragments, Error, TEXT("Decompression failed with error code: %d"), Ret);
+			bSuccess = false;
+			break;
+		}
+
+		OutBuffer.AddUninitialized(Slack - Stream.avail_out);
+	}
+
+	Ret = inflateEnd(&Stream);
+	if (Ret != Z_OK)
+	{
+		UE_LOG(LogFragments, Error, TEXT("zlib end stream failed: %d"), Ret);
+		bSuccess = false;
+	}
+
+	if (!bSuccess)
+	{
+		OutBuffer.Empty();
+		return false;
+	}
+
+	UE_LOG(LogFragments, Log, TEXT("Decompression complete. Total bytes: %d"), OutBuffer.Num());
+	return true;
+}
+
+void UFragmentsImporter::ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode)
+{
+	if (!InOwnerRef || !FragmentModels.Contains(InModelGuid) || IsSpawnTaskRunning(InModelGuid)) return;
+
+	SetOwnerRef(InOwnerRef);
+
+	UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InModelGuid);
+	const Model* ModelRef = Wrapper->GetParsedModel();
+
+	BaseGlassMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentGlassMaterial.M_BaseFragmentGlassMaterial"));
+	BaseMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentMaterial.M_BaseFragmentMaterial"));
+	
+	FDateTime StartTime = FDateTime::Now();
+	BuildRepresentationMeshes(Wrapper, 0, ModelRef->meshes(), InModelGuid, bInSaveMesh, bUseDynamicMesh);
+	Wrapper->SetSpawnedFragment(SpawnFragmentModel(Wrapper->GetModelItem(), OwnerRef, ModelRef->meshes(), bInSaveMesh, Wrapper, bUseDynamicMesh, SpawnMode));
+	UE_LOG(LogFragments, Warning, TEXT("Loaded model in [%s]s -> %s"), *(FDateTime::Now() - StartTime).ToString(), *InModelGuid);
+	if (PackagesToSave.Num() > 0)
+	{
+		DeferredSaveManager.AddPackagesToSave(PackagesToSave);
+		PackagesToSave.Empty();
+	}
+}
+
+void UFragmentsImporter::ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode)
+{
+	FFragmentItem* Item = GetFragmentItemByLocalId(InLocalId, InModelGuid);
+
+	if (!InOwnerRef || !Item || IsSpawnTaskRunning(InModelGuid)) return;
+
+	SetOwnerRef(InOwnerRef);
+
+	UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InModelGuid);
+	const Model* ModelRef = Wrapper->GetParsedModel();
+
+	BaseGlassMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentGlassMaterial.M_BaseFragmentGlassMaterial"));
+	BaseMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentMaterial.M_BaseFragmentMaterial"));
+
+	FDateTime StartTime = FDateTime::Now();
+	BuildRepresentationMeshes(Wrapper, Wrapper->FindItemSlot(InLocalId), ModelRef->meshes(), InModelGuid, bInSaveMesh, bUseDynamicMesh);
+	Wrapper->SetSpawnedFragment(SpawnFragmentModel(*Item, OwnerRef, ModelRef->meshes(), bInSaveMesh, Wrapper, bUseDynamicMesh, SpawnMode), Wrapper->FindItemSlot(InLocalId));
+	UE_LOG(LogFragments, Warning, TEXT("Loaded model in [%s]s -> %s"), *(FDateTime::Now() - StartTime).ToString(), *InModelGuid);
+	if (PackagesToSave.Num() > 0)
+	{
+		DeferredSaveManager.AddPackagesToSave(PackagesToSave);
+		PackagesToSave.Empty();
+	}
+}
+
+int32 UFragmentsImporter::ProcessLoadedFragmentAsync(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, TFunction<void(int32, float)> OnProgress, TFunction<void(int32, AFragment*)> OnCompleted)
+{
+	if (!InOwnerRef || !FragmentModels.Contains(InModelGuid) || IsSpawnTaskRunning(InModelGuid)) return INDEX_NONE;
+
+	SetOwnerRef(InOwnerRef);
+
+	UFragmentModelWrapper* Wrapper = *FragmentModels.Find(InModelGuid);
+	const Model* ModelRef = Wrapper->GetParsedModel();
+
+	BaseGlassMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentGlassMaterial.M_BaseFragmentGlassMaterial"));
+	BaseMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/FragmentsUnreal/Materials/M_BaseFragmentMaterial.M_BaseFragmentMaterial"));
+
+	TSharedPtr<FFragmentSpawnTask> Task = MakeShared<FFragmentSpawnTask>();
+	Task->TaskId = ++LastSpawnTaskId;
+	Task->ModelGuid = InModelGuid;
+	Task->Wrapper.Reset(Wrapper);
+	Task->Owner = InOwnerRef;
+	Task->bSaveMeshes = bInSaveMesh;
+	Task->bUseDynamicMesh = bUseDynamicMesh;
+	Task->SpawnMode = ResolveSpawnMode(SpawnMode, bUseDynamicMesh);
+	Task->BuildSettings = Wrapper->GetMeshBuildSettings();
+	Wrapper->SetDataOnly(Task->SpawnMode == EFragmentSpawnMode::DataOnly);
+	Task->OnProgress = MoveTemp(OnProgress);
+	Task->OnCompleted = MoveTemp(OnCompleted);
+	Task->PendingItems.Emplace(Task->RootItemIndex, InOwnerRef);
+	Task->TotalItems = Wrapper->GetItems().Num();
+
+	CollectRepresentationMeshJobs(Wrapper, Task->RootItemIndex, ModelRef->meshes(), InModelGuid, bUseDynamicMesh, Task->MeshJobs, Task->TaskId);
+	SpawnTasks.Add(Task);
+
+	if (Task->MeshJobs.Num() == 0)
+	{
+		Task->bMeshesGenerated = true;
+	}
+	else
+	{
+		Async(EAsyncExecution::ThreadPool, [Task]() mutable
+			{
+				UFragmentModelWrapper* TaskWrapper = Task->Wrapper.Get();
+				GenerateRepresentationMeshes(Task->MeshJobs, TaskWrapper->GetParsedModel()->meshes(), Task->bUseDynamicMesh, Task->BuildSettings, &TaskWrapper->GetGeometryCache());
+
+				// The task, and the wrapper reference it holds, are released on the game thread
+				AsyncTask(ENamedThreads::GameThread, [Task = MoveTemp(Task)]()
+					{
+						Task->bMeshesGenerated = true;
+					});
+			});
+	}
+
+	if (!SpawnTickerHandle.IsValid())
+	{
+		SpawnTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UFragmentsImporter::TickSpawnTasks));
+	}
+
+	return Task->TaskId;
+}
+
+void UFragmentsImporter::CancelProcessLoadedFragment(int32 TaskId)
+{
+	const TSharedPtr<FFragmentSpawnTask>* Found = SpawnTasks.FindByPredicate([TaskId](const TSharedPtr<FFragmentSpawnTask>& Task)
+		{
+			return Task->TaskId == TaskId;
+		});
+
+	if (Found)
+	{
+		TSharedPtr<FFragmentSpawnTask> Task = *Found;
+		Task->bCancelled = true;
+		FinishSpawnTask(Task);
+	}
+}
+
+bool UFragmentsImporter::TickSpawnTasks(float DeltaTime)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const double Budget = SpawnBudgetMs / 1000.0;
+
+	while (SpawnTasks.Num() > 0 && FPlatformTime::Seconds() - StartTime < Budget)
+	{
+		TSharedPtr<FFragmentSpawnTask> Task = SpawnTasks[0];
+
+		// Tasks run in order, wait for the workers to finish the geometry of the first one
+		if (!Task->bMeshesGenerated) break;
+
+		UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(Task->ModelGuid);
+		if (!WrapperPtr || !Task->Owner.IsValid())
+		{
+			Task->bCancelled = true;
+			FinishSpawnTask(Task);
+			continue;
+		}
+		const Meshes* MeshesRef = (*WrapperPtr)->GetParsedModel()->meshes();
+		const TArray<FFragmentItem>& Items = (*WrapperPtr)->GetItems();
+
+		if (Task->NextMeshJob < Task->MeshJobs.Num())
+		{
+			FinalizeRepresentationMesh(Task->MeshJobs[Task->NextMeshJob++], MeshesRef, Task->ModelGuid, Task->bSaveMeshes, Task->bUseDynamicMesh);
+			continue;
+		}
 
-			for (int32 k = 1; k < Tokens.Num(); ++k)
+		if (Task->NextPendingItem < Task->PendingItems.Num())
+		{
+			const TPair<int32, TWeakObjectPtr<AActor>> Pending = Task->PendingItems[Task->NextPendingItem++];
+
+			// If the parent is gone, its whole subtree is dropped
+			AActor* Parent = Pending.Value.Get();
+			const bool bInstanced = Task->SpawnMode != EFragmentSpawnMode::Actors;
+			AFragment* Fragment = Parent ? SpawnFragmentItem(Items[Pending.Key], Parent, MeshesRef, Task->bSaveMeshes, *WrapperPtr, Task->bUseDynamicMesh, bInstanced ? &Task->Instancing : nullptr) : nullptr;
+			if (!Fragment) continue;
+
+			if (!Task->RootFragment.IsValid())
+			{
+				Task->RootFragment = Fragment;
+			}
+
+			for (const int32 ChildIndex : Items[Pending.Key].ChildIndices)
 			{
-				int32 RelatedLocalId = FCString::Atoi(*Tokens[k].TrimStartAndEnd());
-				if (Visited.Contains(RelatedLocalId)) continue;
+				// DataOnly only spawns the root, the rest of the tree becomes instances
+				if (Task->SpawnMode == EFragmentSpawnMode::DataOnly)
+					Task->PendingInstances.Emplace(ChildIndex, Items[ChildIndex].GlobalTransform);
+				else
+					Task->PendingItems.Emplace(ChildIndex, Fragment);
+			}
+			continue;
+		}
+
+		if (Task->NextPendingInstance < Task->PendingInstances.Num())
+		{
+			const TPair<int32, FTransform> Pending = Task->PendingInstances[Task->NextPendingInstance++];
+			AddItemInstances(Task->Instancing, Items[Pending.Key], Pending.Value, MeshesRef, Task->bSaveMeshes);
 
-				// Try resolving RelatedLocalId to attribute
-				flatbuffers::uoffset_t AttrIndex = UFragmentsUtils::GetIndexForLocalId(InModel, RelatedLocalId);
-				if (AttrIndex != INDEX_NONE && attributes && AttrIndex < attributes->size())
+			for (const int32 ChildIndex : Items[Pending.Key].ChildIndices)
+			{
+				Task->PendingInstances.Emplace(ChildIndex, Items[ChildIndex].GlobalTransform * Pending.Value);
+			}
+			continue;
+		}
+
+		FinishSpawnTask(Task);
+	}
+
+	if (SpawnTasks.Num() > 0)
+	{
+		const TSharedPtr<FFragmentSpawnTask>& Task = SpawnTasks[0];
+		FlushSampleInstances(Task->Instancing);
+
+		if (Task->OnProgress && Task->bMeshesGenerated)
+		{
+			const int32 Total = Task->MeshJobs.Num() + Task->TotalItems;
+			const int32 Done = Task->NextMeshJob + Task->NextPendingItem + Task->NextPendingInstance;
+			Task->OnProgress(Task->TaskId, Total > 0 ? (float)Done / Total : 1.0f);
+		}
+		return true; // keep ticking
+	}
+
+	SpawnTickerHandle.Reset();
+	return false; // unregister ticker
+}
+
+bool UFragmentsImporter::IsSpawnTaskRunning(const FString& ModelGuid) const
+{
+	const bool bRunning = SpawnTasks.ContainsByPredicate([&ModelGuid](const TSharedPtr<FFragmentSpawnTask>& Task)
+		{
+			return Task->ModelGuid == ModelGuid;
+		});
+
+	if (bRunning)
+	{
+		UE_LOG(LogFragments, Warning, TEXT("Model %s is already being spawned, cancel its task first"), *ModelGuid);
+	}
+	return bRunning;
+}
+
+void UFragmentsImporter::SetupComponentCollision(UPrimitiveComponent* InComponent, const FString& Category, const FFragmentMeshBuildSettings& Settings)
+{
+	// Nothing gets cooked while the component registers
+	InComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	if (!Settings.WantsCollision(Category)) return;
+
+	InComponent->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Block);
+
+	// Static meshes carry their shapes in their body setup, see CreateStaticMeshFromDescription
+	if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(InComponent))
+	{
+		if (Settings.CollisionMode != EFragmentCollisionMode::ComplexAsSimple)
+		{
+			TArray<FVector> Points;
+			DynamicMeshComponent->ProcessMesh([&Points](const FDynamicMesh3& Mesh)
 				{
-					const auto* Attr = attributes->Get(AttrIndex);
-					if (Attr)
+					Points.Reserve(Mesh.VertexCount());
+					for (const FVector3d& Vertex : Mesh.VerticesItr())
 					{
-						TArray<FItemAttribute> Props = UFragmentsUtils::ParseItemAttribute(Attr);
-						OutAttributes.Append(Props);
+						Points.Add(Vertex);
 					}
-				}
+				});
+
+			// A box or a single hull, nothing worth cooking on worker threads
+			DynamicMeshComponent->bUseAsyncCooking = false;
+			DynamicMeshComponent->CollisionType = ECollisionTraceFlag::CTF_UseSimpleAsComplex;
+			DynamicMeshComponent->SetSimpleCollisionShapes(MakeSimpleCollision(Settings.CollisionMode, Points), true);
+			InComponent->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+			return;
+		}
+
+		// Its body setup reads the triangles from the component and is cooked like a static mesh one
+		DynamicMeshComponent->SetComplexAsSimpleCollisionEnabled(true, false);
+	}
+
+	if (!Settings.bCookCollisionAsync)
+	{
+		// Cooked on the game thread when the component registers
+		InComponent->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+		return;
+	}
+
+	QueueComponentCollision(InComponent);
+}
+
+void UFragmentsImporter::QueueComponentCollision(UPrimitiveComponent* InComponent)
+{
+	FFragmentPendingCollision& Pending = PendingCollision.AddDefaulted_GetRef();
+	Pending.Component = InComponent;
+	Pending.SpawnFrame = GFrameCounter;
+
+	if (!CollisionTickerHandle.IsValid())
+	{
+		CollisionTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UFragmentsImporter::TickCollisionCooking));
+	}
+}
+
+TMap<TWeakObjectPtr<UPrimitiveComponent>, TWeakObjectPtr<UFragmentsImporter>>& UFragmentsImporter::HiddenPendingCollision()
+{
+	static TMap<TWeakObjectPtr<UPrimitiveComponent>, TWeakObjectPtr<UFragmentsImporter>> S;
+	return S;
+}
+
+bool UFragmentsImporter::ResumeComponentCollision(UPrimitiveComponent* InComponent)
+{
+	TWeakObjectPtr<UFragmentsImporter> Importer;
+	if (!HiddenPendingCollision().RemoveAndCopyValue(InComponent, Importer) || !Importer.IsValid()) return false;
+
+	Importer->QueueComponentCollision(InComponent);
+	return true;
+}
+
+bool UFragmentsImporter::TickCollisionCooking(float DeltaTime)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const double Budget = SpawnBudgetMs / 1000.0;
+
+	for (int32 Index = 0; Index < PendingCollision.Num() && FPlatformTime::Seconds() - StartTime < Budget;)
+	{
+		FFragmentPendingCollision& Pending = PendingCollision[Index];
+		UPrimitiveComponent* Component = Pending.Component.Get();
+		if (!Component)
+		{
+			PendingCollision.RemoveAtSwap(Index);
+			continue;
+		}
+
+		// Hidden items would block the player, and showing them again restores the NoCollision they were hidden with.
+		// They leave the queue until ResumeComponentCollision puts them back.
+		const AActor* Owner = Component->GetOwner();
+		if (Component->bHiddenInGame || (Owner && Owner->IsHidden()))
+		{
+			HiddenPendingCollision().Add(Component, this);
+			PendingCollision.RemoveAtSwap(Index);
+			continue;
+		}
 
-				// Recurse
-				CollectPropertiesRecursive(InModel, RelatedLocalId, Visited, OutAttributes);
+		bool bCooked = true;
+		if (Pending.SpawnFrame == GFrameCounter)
+		{
+			bCooked = false;
+		}
+		else if (UBodySetup* BodySetup = Component->GetBodySetup())
+		{
+			if (!BodySetup->bCreatedPhysicsMeshes)
+			{
+				if (const bool* bFinished = CookingBodySetups.Find(BodySetup))
+				{
+					bCooked = *bFinished;
+				}
+				else
+				{
+					CookingBodySetups.Add(BodySetup, false);
+					BodySetup->CreatePhysicsMeshesAsync(FOnAsyncPhysicsCookFinished::CreateUObject(this, &UFragmentsImporter::OnCollisionCooked, TWeakObjectPtr<UBodySetup>(BodySetup)));
+					bCooked = false;
+				}
 			}
 		}
+
+		if (!bCooked)
+		{
+			Index++;
+			continue;
+		}
+
+		Component->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+		PendingCollision.RemoveAtSwap(Index);
+	}
+
+	if (PendingCollision.Num() > 0)
+	{
+		return true; // keep ticking
+	}
+
+	// Cooks still running keep their entry so they aren't started twice
+	for (auto It = CookingBodySetups.CreateIterator(); It; ++It)
+	{
+		if (It.Value() || !It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+	for (auto It = HiddenPendingCollision().CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid() || !It.Value().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	CollisionTickerHandle.Reset();
+	return false; // unregister ticker
+}
+
+void UFragmentsImporter::OnCollisionCooked(bool bSuccess, TWeakObjectPtr<UBodySetup> BodySetup)
+{
+	if (!bSuccess)
+	{
+		UE_LOG(LogFragments, Warning, TEXT("Failed to cook collision of %s"), BodySetup.IsValid() ? *GetNameSafe(BodySetup->GetOuter()) : TEXT("a destroyed mesh"));
+	}
+
+	// Components waiting on it are enabled by the next TickCollisionCooking, a failed cook is retried on the game thread
+	if (bool* bFinished = CookingBodySetups.Find(BodySetup))
+	{
+		*bFinished = true;
+	}
+}
+
+void UFragmentsImporter::FinishSpawnTask(const TSharedPtr<FFragmentSpawnTask>& Task)
+{
+	TSharedPtr<FFragmentSpawnTask> KeepAlive = Task;
+	SpawnTasks.Remove(KeepAlive);
+	FlushSampleInstances(KeepAlive->Instancing);
+
+	// Meshes a cancelled task didn't get to are built by the next spawn that uses them
+	for (auto It = InFlightStaticMeshes.CreateIterator(); It; ++It)
+	{
+		if (It.Value() == KeepAlive->TaskId)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	if (PackagesToSave.Num() > 0)
+	{
+		DeferredSaveManager.AddPackagesToSave(PackagesToSave);
+		PackagesToSave.Empty();
+	}
+
+	// Whatever was spawned is registered on the wrapper so UnloadFragment can clean it up
+	AFragment* RootFragment = KeepAlive->RootFragment.Get();
+	if (RootFragment)
+	{
+		if (UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(KeepAlive->ModelGuid))
+		{
+			(*WrapperPtr)->SetSpawnedFragment(RootFragment, KeepAlive->RootItemIndex);
+		}
+	}
+
+	if (KeepAlive->bCancelled)
+	{
+		UE_LOG(LogFragments, Log, TEXT("Fragment spawn task %d was cancelled"), KeepAlive->TaskId);
+	}
+	else if (KeepAlive->OnProgress)
+	{
+		KeepAlive->OnProgress(KeepAlive->TaskId, 1.0f);
+	}
+
+	if (KeepAlive->OnCompleted)
+	{
+		KeepAlive->OnCompleted(KeepAlive->TaskId, KeepAlive->bCancelled ? nullptr : RootFragment);
+	}
+}
+
+TArray<int32> UFragmentsImporter::GetElementsByCategory(const FString& InCategory, const FString& ModelGuid)
+{
+	if (UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid))
+	{
+		if (const TArray<int32>* LocalIds = (*WrapperPtr)->FindLocalIdsByCategory(InCategory))
+		{
+			return *LocalIds;
+		}
+	}
+	return TArray<int32>();
+}
+
+TArray<int32> UFragmentsImporter::GetElementsByCategories(const TArray<FString>& InCategories, const FString& ModelGuid)
+{
+	TArray<int32> LocalIds;
+
+	UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid);
+	if (!WrapperPtr) return LocalIds;
+
+	// Every item has one category, so the union is the buckets appended once each
+	TSet<const TArray<int32>*> Added;
+	for (const FString& Category : InCategories)
+	{
+		const TArray<int32>* Bucket = (*WrapperPtr)->FindLocalIdsByCategory(Category);
+		if (!Bucket) continue;
+
+		bool bAlreadyAdded = false;
+		Added.Add(Bucket, &bAlreadyAdded);
+		if (!bAlreadyAdded) LocalIds.Append(*Bucket);
+	}
+	return LocalIds;
+}
+
+TArray<FFragmentCategoryElements> UFragmentsImporter::GetElementsByCategoriesGrouped(const TArray<FString>& InCategories, const FString& ModelGuid)
+{
+	TArray<FFragmentCategoryElements> Groups;
+
+	UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid);
+	if (!WrapperPtr) return Groups;
+
+	Groups.Reserve(InCategories.Num());
+	for (const FString& Category : InCategories)
+	{
+		FFragmentCategoryElements& Group = Groups.AddDefaulted_GetRef();
+		Group.Category = Category;
+		if (const TArray<int32>* Bucket = (*WrapperPtr)->FindLocalIdsByCategory(Category))
+		{
+			Group.LocalIds = *Bucket;
+		}
+	}
+	return Groups;
+}
+
+TArray<FString> UFragmentsImporter::GetCategories(const FString& ModelGuid)
+{
+	TArray<FString> Categories;
+	if (UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid))
+	{
+		(*WrapperPtr)->GetCategories(Categories);
+	}
+	return Categories;
+}
+
+TArray<int32> UFragmentsImporter::GetElementsInBox(const FBox& Box, const FString& ModelGuid)
+{
+	TArray<int32> LocalIds;
+
+	UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid);
+	if (!WrapperPtr) return LocalIds;
+
+	// Conservative when the owner is rotated, the box is widened to stay axis aligned in model space
+	TArray<int32> Primitives;
+	(*WrapperPtr)->GetSpatialIndex().QueryBox(Box.InverseTransformBy(GetModelToWorld(*WrapperPtr)), Primitives);
+	(*WrapperPtr)->GetSpatialLocalIds(Primitives, LocalIds);
+	return LocalIds;
+}
+
+TArray<int32> UFragmentsImporter::GetElementsInSphere(const FVector& Center, float Radius, const FString& ModelGuid)
+{
+	TArray<int32> LocalIds;
+
+	UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid);
+	if (!WrapperPtr) return LocalIds;
+
+	const FTransform ModelToWorld = GetModelToWorld(*WrapperPtr);
+	const double ModelRadius = Radius / FMath::Max(ModelToWorld.GetScale3D().GetAbsMin(), UE_SMALL_NUMBER);
+
+	TArray<int32> Primitives;
+	(*WrapperPtr)->GetSpatialIndex().QuerySphere(FSphere(ModelToWorld.InverseTransformPosition(Center), ModelRadius), Primitives);
+	(*WrapperPtr)->GetSpatialLocalIds(Primitives, LocalIds);
+	return LocalIds;
+}
+
+TArray<int32> UFragmentsImporter::GetElementsInFrustum(const FConvexVolume& Frustum, const FString& ModelGuid)
+{
+	TArray<int32> LocalIds;
+
+	UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid);
+	if (!WrapperPtr) return LocalIds;
+
+	const FMatrix WorldToModel = GetModelToWorld(*WrapperPtr).ToInverseMatrixWithScale();
+	FConvexVolume ModelFrustum;
+	for (const FPlane& Plane : Frustum.Planes)
+	{
+		ModelFrustum.Planes.Add(Plane.TransformBy(WorldToModel));
+	}
+	ModelFrustum.Init();
+
+	TArray<int32> Primitives;
+	(*WrapperPtr)->GetSpatialIndex().QueryFrustum(ModelFrustum, Primitives);
+	(*WrapperPtr)->GetSpatialLocalIds(Primitives, LocalIds);
+	return LocalIds;
+}
+
+TArray<int32> UFragmentsImporter::GetElementsInFrustum(const FMinimalViewInfo& View, const FString& ModelGuid)
+{
+	FMatrix ViewMatrix, ProjectionMatrix, ViewProjectionMatrix;
+	UGameplayStatics::GetViewProjectionMatrix(View, ViewMatrix, ProjectionMatrix, ViewProjectionMatrix);
+
+	FConvexVolume Frustum;
+	GetViewFrustumBounds(Frustum, ViewProjectionMatrix, true);
+	return GetElementsInFrustum(Frustum, ModelGuid);
+}
+
+int32 UFragmentsImporter::GetNearestElement(const FVector& Point, const FString& ModelGuid)
+{
+	UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid);
+	if (!WrapperPtr) return INDEX_NONE;
+
+	const int32 Primitive = (*WrapperPtr)->GetSpatialIndex().FindNearest(GetModelToWorld(*WrapperPtr).InverseTransformPosition(Point));
+	if (Primitive == INDEX_NONE) return INDEX_NONE;
+
+	return (*WrapperPtr)->GetItems()[(*WrapperPtr)->GetSpatialSample(Primitive).X].LocalId;
+}
+
+bool UFragmentsImporter::RaycastFragments(const FVector& Origin, const FVector& Direction, float MaxDistance, FFragmentRaycastHit& OutHit)
+{
+	OutHit = FFragmentRaycastHit();
+	const FVector RayDirection = Direction.GetSafeNormal();
+	if (RayDirection.IsZero() || MaxDistance <= 0.0f) return false;
+
+	double ClosestDistance = MaxDistance;
+	for (const TPair<FString, UFragmentModelWrapper*>& Pair : FragmentModels)
+	{
+		// Only what was spawned can be picked: models that are only loaded have no place in the world
+		UFragmentModelWrapper* Wrapper = Pair.Value;
+		if (!Wrapper || !IsValid(Wrapper->GetSpawnedFragment()) || Wrapper->GetSpatialIndex().IsEmpty()) continue;
+		const int32 SpawnedItemSlot = Wrapper->GetSpawnedItemSlot();
+
+		// Directions are moved between spaces without normalizing, so distances stay in world cm everywhere
+		const FTransform ModelToWorld = GetModelToWorld(Wrapper);
+		const FVector ModelOrigin = ModelToWorld.InverseTransformPosition(Origin);
+		const FVector ModelDirection = ModelToWorld.InverseTransformVector(RayDirection);
+
+		FVector HitNormal = FVector::ZeroVector;
+		double HitDistance = 0.0;
+		const int32 HitPrimitive = Wrapper->GetSpatialIndex().Raycast(ModelOrigin, ModelDirection, ClosestDistance,
+			[this, Wrapper, SpawnedItemSlot, &ModelOrigin, &ModelDirection, &HitNormal](int32 Primitive, double ClosestSoFar) -> double
+			{
+				const FIntPoint& Entry = Wrapper->GetSpatialSample(Primitive);
+				if (SpawnedItemSlot != 0 && !Wrapper->IsItemInSubtree(Entry.X, SpawnedItemSlot)) return -1.0;
+
+				const FDynamicMesh3* Mesh = FindOrBuildPickingMesh(Wrapper, Wrapper->GetItems()[Entry.X].Samples[Entry.Y]);
+				if (!Mesh) return -1.0;
+
+				const FTransform& SampleToModel = Wrapper->GetSpatialTransform(Primitive);
+				const FVector LocalOrigin = SampleToModel.InverseTransformPosition(ModelOrigin);
+				const FVector LocalDirection = SampleToModel.InverseTransformVector(ModelDirection);
+
+				// Two sided Moller-Trumbore against every triangle, shells are small enough not to need a tree of their own
+				double Closest = ClosestSoFar;
+				FVector ClosestNormal = FVector::ZeroVector;
+				for (const int32 TriangleId : Mesh->TriangleIndicesItr())
+				{
+					FVector3d A, B, C;
+					Mesh->GetTriVertices(TriangleId, A, B, C);
+					const FVector EdgeAB = B - A;
+					const FVector EdgeAC = C - A;
+					const FVector P = FVector::CrossProduct(LocalDirection, EdgeAC);
+					const double Determinant = FVector::DotProduct(EdgeAB, P);
+					if (FMath::Abs(Determinant) < UE_DOUBLE_SMALL_NUMBER) continue;
+
+					const double InvDeterminant = 1.0 / Determinant;
+					const FVector ToOrigin = LocalOrigin - A;
+					const double U = FVector::DotProduct(ToOrigin, P) * InvDeterminant;
+					if (U < 0.0 || U > 1.0) continue;
+
+					const FVector Q = FVector::CrossProduct(ToOrigin, EdgeAB);
+					const double V = FVector::DotProduct(LocalDirection, Q) * InvDeterminant;
+					if (V < 0.0 || U + V > 1.0) continue;
+
+					const double T = FVector::DotProduct(EdgeAC, Q) * InvDeterminant;
+					if (T >= 0.0 && T < Closest)
+					{
+						Closest = T;
+						ClosestNormal = FVector::CrossProduct(EdgeAB, EdgeAC);
+					}
+				}
+				if (Closest >= ClosestSoFar) return -1.0;
+
+				// Normals follow the inverse transpose, so non uniform scale keeps them perpendicular
+				const FVector ModelNormal = SampleToModel.GetRotation().RotateVector(ClosestNormal * SampleToModel.GetSafeScaleReciprocal(SampleToModel.GetScale3D()));
+				HitNormal = ModelNormal;
+				return Closest;
+			}, &HitDistance);
+
+		if (HitPrimitive == INDEX_NONE) continue;
+
+		FVector WorldNormal = ModelToWorld.GetRotation().RotateVector(HitNormal * ModelToWorld.GetSafeScaleReciprocal(ModelToWorld.GetScale3D())).GetSafeNormal();
+		if (FVector::DotProduct(WorldNormal, RayDirection) > 0.0)
+		{
+			WorldNormal = -WorldNormal;
+		}
+
+		ClosestDistance = HitDistance;
+		OutHit.ModelGuid = Pair.Key;
+		OutHit.LocalId = Wrapper->GetItems()[Wrapper->GetSpatialSample(HitPrimitive).X].LocalId;
+		OutHit.Location = Origin + RayDirection * HitDistance;
+		OutHit.Normal = WorldNormal;
+		OutHit.Distance = HitDistance;
+	}
+
+	return OutHit.LocalId != INDEX_NONE;
+}
+
+const FDynamicMesh3* UFragmentsImporter::FindOrBuildPickingMesh(UFragmentModelWrapper* Wrapper, const FFragmentSample& Sample)
+{
+	// Meshes spawned with the dynamic mesh path are reused, the geometry is identical
+	if (const FDynamicMesh3* Found = DynamicMeshByGeometryHash.Find(Sample.GeometryHash))
+	{
+		return Found;
+	}
+	if (const FDynamicMesh3* Found = Wrapper->FindPickingMesh(Sample.GeometryHash))
+	{
+		return Found;
+	}
+
+	const Meshes* MeshesRef = Wrapper->GetParsedModel() ? Wrapper->GetParsedModel()->meshes() : nullptr;
+	if (!MeshesRef || !MeshesRef->representations()) return nullptr;
+
+	const Representation* representation = MeshesRef->representations()->Get(Sample.RepresentationIndex);
+	if (!representation) return nullptr;
+
+	FDynamicMesh3 Mesh;
+	if (Wrapper->GetGeometryCache().Find(Sample.GeometryHash, Mesh))
+	{
+		// The cache only keeps positions and triangles
+		if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
+		{
+			ApplyHardEdgeNormals(Mesh, Wrapper->GetMeshBuildSettings());
+		}
+	}
+	else
+	{
+		if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
+		{
+			const auto* shell = MeshesRef->shells() ? MeshesRef->shells()->Get(representation->id()) : nullptr;
+			if (!shell || !shell->points() || !shell->profiles()) return nullptr;
+			Mesh = CreateDynamicMeshFromShell(shell, Wrapper->GetMeshBuildSettings());
+		}
+		else if (representation->representation_class() == RepresentationClass_CIRCLE_EXTRUSION)
+		{
+			if (!MeshesRef->circle_extrusions()) return nullptr;
+			const auto* circleExtrusion = MeshesRef->circle_extrusions()->Get(representation->id());
+			if (!circleExtrusion || !circleExtrusion->axes() || circleExtrusion->axes()->size() == 0) return nullptr;
+			Mesh = CreateDynamicMeshFromCircleExtrusion(circleExtrusion, Wrapper->GetMeshBuildSettings());
+		}
+		else
+		{
+			return nullptr;
+		}
 	}
+
+	// Kept with the model rather than in DynamicMeshByGeometryHash, so unloading it frees them
+	return Wrapper->AddPickingMesh(Sample.GeometryHash, MoveTemp(Mesh));
+}
+
+void UFragmentsImporter::UnloadFragment(const FString& ModelGuid)
+{
+	for (int32 i = SpawnTasks.Num() - 1; i >= 0; --i)
+	{
+		if (SpawnTasks[i]->ModelGuid == ModelGuid)
+		{
+			CancelProcessLoadedFragment(SpawnTasks[i]->TaskId);
+		}
+	}
+
+	if (FFragmentLookup* Lookup = ModelFragmentsMap.Find(ModelGuid))
+	{
+		for (TPair<int32, AFragment*> Obj : Lookup->Fragments)
+		{
+			Obj.Value->Destroy();
+		}
+		ModelFragmentsMap.Remove(ModelGuid);
+	}
+
+	if (UFragmentModelWrapper** WrapperPtr = FragmentModels.Find(ModelGuid))
+	{
+		UFragmentModelWrapper* Wrapper = *WrapperPtr;
+
+		Wrapper = nullptr;
+		FragmentModels.Remove(ModelGuid);
+	}
+}
+
+AFragment* UFragmentsImporter::GetModelFragment(const FString& ModelGuid)
+{
+	if (FragmentModels.Contains(ModelGuid))
+	{
+		UFragmentModelWrapper* Wrapper = *FragmentModels.Find(ModelGuid);
+		return Wrapper->GetSpawnedFragment();
+	}
+	return nullptr;
+}
+
+void UFragmentsImporter::CollectPropertiesRecursive(
+	const UFragmentModelWrapper* Wrapper,
+	int32 StartLocalId,
+	TSet<int32>& Visited,
+	TArray<int32>& OutRows)
+{
+	const Model* InModel = Wrapper ? Wrapper->GetParsedModel() : nullptr;
+	if (!InModel || Visited.Contains(StartLocalId)) return;
+	Visited.Add(StartLocalId);
+
+	const FFragmentAttributeTable& AttributeTable = Wrapper->GetAttributeTable();
+	const FFragmentRelationIndex& RelationIndex = Wrapper->GetRelationIndex();
+
+	// Only allow property-related relations
+	const int32 PropertyRelations[] = {
+		RelationIndex.FindRelationType(TEXT("IsDefinedBy")),
+		RelationIndex.FindRelationType(TEXT("HasProperties")),
+		RelationIndex.FindRelationType(TEXT("DefinesType"))
+	};
+
+	RelationIndex.ForEachRelated(StartLocalId, PropertyRelations, [this, Wrapper, &AttributeTable, &Visited, &OutRows](int32 RelationType, int32 RelatedLocalId)
+		{
+			if (Visited.Contains(RelatedLocalId)) return;
+
+			// Try resolving RelatedLocalId to its attribute rows
+			const int32 AttrIndex = Wrapper->GetIndexForLocalId(RelatedLocalId);
+			if (AttrIndex != INDEX_NONE)
+			{
+				const int32 FirstRow = AttributeTable.GetFirstRow(AttrIndex);
+				for (int32 Row = FirstRow; Row < FirstRow + AttributeTable.GetNumRows(AttrIndex); Row++)
+				{
+					OutRows.Add(Row);
+				}
+			}
+
+			// Recurse
+			CollectPropertiesRecursive(Wrapper, RelatedLocalId, Visited, OutRows);
+		});
 }
 
 
@@ -707,7 +1757,7 @@ void UFragmentsImporter::SpawnFragmentModel(AFragment* InFragmentModel, AActor*
 				if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
 				{
 					const auto* shell = MeshesRef->shells()->Get(representation->id());
-					Mesh = CreateStaticMeshFromShell(shell, material, *MeshName, MeshPackage, InFragmentModel->GetModelGuid());
+					Mesh = CreateStaticMeshFromShell(shell, material, *MeshName, MeshPackage, InFragmentModel->GetModelGuid(), UFragmentsUtils::MakeBox(representation->bbox()));
 
 				}
 				else if (representation->representation_class() == RepresentationClass_CIRCLE_EXTRUSION)
@@ -747,6 +1797,12 @@ void UFragmentsImporter::SpawnFragmentModel(AFragment* InFragmentModel, AActor*
 				// Add StaticMeshComponent to parent actor
 				UStaticMeshComponent* MeshComp = NewObject<UStaticMeshComponent>(InFragmentModel);
 				MeshComp->SetStaticMesh(Mesh);
+				const FFragmentMeshBuildSettings& Settings = GetModelMeshBuildSettings(InFragmentModel->GetModelGuid());
+				if (Settings.bUseMaterialPalette)
+				{
+					ApplyPaletteMaterial(MeshComp, material);
+				}
+				SetupComponentCollision(MeshComp, InFragmentModel->GetCategory(), Settings);
 				MeshComp->SetRelativeTransform(LocalTransform); // local to parent
 				MeshComp->AttachToComponent(RootSceneComponent, FAttachmentTransformRules::KeepRelativeTransform);
 				MeshComp->RegisterComponent();
@@ -762,14 +1818,73 @@ void UFragmentsImporter::SpawnFragmentModel(AFragment* InFragmentModel, AActor*
 	}
 }
 
-AFragment* UFragmentsImporter::SpawnFragmentModel(FFragmentItem InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh)
+AFragment* UFragmentsImporter::SpawnFragmentModel(const FFragmentItem& InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode)
+{
+	const EFragmentSpawnMode Mode = ResolveSpawnMode(SpawnMode, bUseDynamicMesh);
+	InWrapperRef->SetDataOnly(Mode == EFragmentSpawnMode::DataOnly);
+
+	if (Mode == EFragmentSpawnMode::Actors)
+	{
+		return SpawnFragmentModel(InFragmentItem, InParent, MeshesRef, bSaveMeshes, InWrapperRef, bUseDynamicMesh, nullptr);
+	}
+
+	FFragmentInstancingContext Instancing;
+	AFragment* FragmentModel = nullptr;
+	if (Mode == EFragmentSpawnMode::Instanced)
+	{
+		FragmentModel = SpawnFragmentModel(InFragmentItem, InParent, MeshesRef, bSaveMeshes, InWrapperRef, false, &Instancing);
+	}
+	else
+	{
+		// Only the root becomes an actor, every other item is drawn through the root's instanced components
+		FragmentModel = SpawnFragmentItem(InFragmentItem, InParent, MeshesRef, bSaveMeshes, InWrapperRef, false, &Instancing);
+		if (FragmentModel)
+		{
+			const TArray<FFragmentItem>& Items = InWrapperRef->GetItems();
+			TArray<TPair<int32, FTransform>> Stack;
+			for (const int32 ChildIndex : InFragmentItem.ChildIndices)
+			{
+				Stack.Emplace(ChildIndex, Items[ChildIndex].GlobalTransform);
+			}
+
+			while (Stack.Num() > 0)
+			{
+				const TPair<int32, FTransform> Entry = Stack.Pop();
+				AddItemInstances(Instancing, Items[Entry.Key], Entry.Value, MeshesRef, bSaveMeshes);
+
+				for (const int32 ChildIndex : Items[Entry.Key].ChildIndices)
+				{
+					Stack.Emplace(ChildIndex, Items[ChildIndex].GlobalTransform * Entry.Value);
+				}
+			}
+		}
+	}
+
+	FlushSampleInstances(Instancing);
+	return FragmentModel;
+}
+
+AFragment* UFragmentsImporter::SpawnFragmentModel(const FFragmentItem& InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh, FFragmentInstancingContext* Instancing)
+{
+	AFragment* FragmentModel = SpawnFragmentItem(InFragmentItem, InParent, MeshesRef, bSaveMeshes, InWrapperRef, bUseDynamicMesh, Instancing);
+	if (!FragmentModel) return nullptr;
+
+	// Recursively spawn child fragments
+	for (const int32 ChildIndex : InFragmentItem.ChildIndices)
+	{
+		SpawnFragmentModel(InWrapperRef->GetItems()[ChildIndex], FragmentModel, MeshesRef, bSaveMeshes, InWrapperRef, bUseDynamicMesh, Instancing);
+	}
+
+	return FragmentModel;
+}
+
+AFragment* UFragmentsImporter::SpawnFragmentActor(const FFragmentItem& InFragmentItem, AActor* InParent, const FTransform& InRelativeTransform)
 {
 	if (!InParent) return nullptr;
-	bSaveMaterials = bSaveMeshes;
 	// Create AFragment
 
-	AFragment* FragmentModel = OwnerRef->GetWorld()->SpawnActor<AFragment>(
-		AFragment::StaticClass(), InFragmentItem.GlobalTransform);
+	AFragment* FragmentModel = InParent->GetWorld()->SpawnActor<AFragment>(
+		AFragment::StaticClass(), InRelativeTransform);
 
 	// Root Component
 	USceneComponent* RootSceneComponent = NewObject<USceneComponent>(FragmentModel);
@@ -777,16 +1892,40 @@ AFragment* UFragmentsImporter::SpawnFragmentModel(FFragmentItem InFragmentItem,
 	FragmentModel->SetRootComponent(RootSceneComponent);
 	RootSceneComponent->SetMobility(EComponentMobility::Movable);
 
-	// Set Transform and Info
-	FTransform RootTransform = UFragmentsUtils::MakeTransform(MeshesRef->coordinates());
-	FragmentModel->SetActorTransform(InFragmentItem.GlobalTransform);
-	FragmentModel->SetData(InFragmentItem);
-	FragmentModel->AttachToActor(InParent, FAttachmentTransformRules::KeepRelativeTransform);
+	// Set Transform and Info
+	FragmentModel->SetActorTransform(InRelativeTransform);
+	FragmentModel->SetData(InFragmentItem);
+	FragmentModel->AttachToActor(InParent, FAttachmentTransformRules::KeepRelativeTransform);
+
+#if WITH_EDITOR
+	if (!FragmentModel->GetCategory().IsEmpty())
+		FragmentModel->SetActorLabel(FragmentModel->GetCategory());
+#endif
+
+	if (ModelFragmentsMap.Contains(InFragmentItem.ModelGuid))
+	{
+		ModelFragmentsMap[InFragmentItem.ModelGuid].Fragments.Add(InFragmentItem.LocalId, FragmentModel);
+	}
+
+	return FragmentModel;
+}
+
+AFragment* UFragmentsImporter::SpawnFragmentItem(const FFragmentItem& InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh, FFragmentInstancingContext* Instancing)
+{
+	bSaveMaterials = bSaveMeshes;
+
+	AFragment* FragmentModel = SpawnFragmentActor(InFragmentItem, InParent, InFragmentItem.GlobalTransform);
+	if (!FragmentModel) return nullptr;
+	USceneComponent* RootSceneComponent = FragmentModel->GetRootComponent();
 
-#if WITH_EDITOR
-	if (!FragmentModel->GetCategory().IsEmpty())
-		FragmentModel->SetActorLabel(FragmentModel->GetCategory());
-#endif
+	// Instances live on the first spawned fragment, in its local space
+	if (Instancing && !Instancing->Root.IsValid())
+	{
+		Instancing->Root = FragmentModel;
+	}
+	const FTransform ItemToInstancingRoot = Instancing && Instancing->Root.IsValid()
+		? FragmentModel->GetActorTransform().GetRelativeTransform(Instancing->Root->GetActorTransform())
+		: FTransform::Identity;
 
 	// Create Meshes If Sample Exists
 	const TArray<FFragmentSample>& Samples = FragmentModel->GetSamples();
@@ -802,39 +1941,30 @@ AFragment* UFragmentsImporter::SpawnFragmentModel(FFragmentItem InFragmentItem,
 
 			const uint32 repId = representation->id();
 
-			FString MeshName = FString::Printf(TEXT("rep_%u"), repId);
-			FString PackagePath = TEXT("/Game/Buildings") / FragmentModel->GetModelGuid() / MeshName;
-			const FString SamplePath = PackagePath + TEXT(".") + MeshName;
-
-			FString UniquePackageName = FPackageName::ObjectPathToPackageName(PackagePath);
-			FString PackageFileName = FPackageName::LongPackageNameToFilename(UniquePackageName, FPackageName::GetAssetPackageExtension());
-
-
 			FTransform LocalTransform = UFragmentsUtils::MakeTransform(local_transform);
 
 			if (bUseDynamicMesh)
 			{
 				FDynamicMesh3 DynamicMesh;	
 
-				if (FDynamicMesh3* FoundDyn = DynamicMeshByRepId.Find(repId))
+				if (FDynamicMesh3* FoundDyn = DynamicMeshByGeometryHash.Find(Sample.GeometryHash))
 				{
 					DynamicMesh = *FoundDyn;
 				}
 				else
 				{
 					// Class Shell
-					UPackage* MeshPackage = CreatePackage(*PackagePath);
 					if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
 					{
 						const auto* shell = MeshesRef->shells()->Get(representation->id());
-						DynamicMesh = CreateDynamicMeshFromShell(shell, material, *MeshName, MeshPackage);
-						DynamicMeshByRepId.Add(repId, DynamicMesh);
+						DynamicMesh = CreateDynamicMeshFromShell(shell, InWrapperRef->GetMeshBuildSettings());
+						DynamicMeshByGeometryHash.Add(Sample.GeometryHash, DynamicMesh);
 					}
 					else if (representation->representation_class() == RepresentationClass_CIRCLE_EXTRUSION)
 					{
 						const auto* circleExtrusion = MeshesRef->circle_extrusions()->Get(representation->id());
-						DynamicMesh = CreateDynamicMeshFromCircleExtrusion(circleExtrusion, material, *MeshName, MeshPackage);
-						DynamicMeshByRepId.Add(repId, DynamicMesh);
+						DynamicMesh = CreateDynamicMeshFromCircleExtrusion(circleExtrusion, InWrapperRef->GetMeshBuildSettings());
+						DynamicMeshByGeometryHash.Add(Sample.GeometryHash, DynamicMesh);
 					}
 
 				}
@@ -843,78 +1973,33 @@ AFragment* UFragmentsImporter::SpawnFragmentModel(FFragmentItem InFragmentItem,
 				UDynamicMeshComponent* DynamicMeshComponent = NewObject<UDynamicMeshComponent>(FragmentModel);
 				DynamicMeshComponent->SetMesh(MoveTemp(DynamicMesh));
 				AddMaterialToDynamicMesh(DynamicMeshComponent, material, InWrapperRef, Sample.MaterialIndex);
+				SetupComponentCollision(DynamicMeshComponent, InFragmentItem.Category, InWrapperRef->GetMeshBuildSettings());
 				DynamicMeshComponent->SetRelativeTransform(LocalTransform); // local to parent
 				DynamicMeshComponent->AttachToComponent(RootSceneComponent, FAttachmentTransformRules::KeepRelativeTransform);
 				DynamicMeshComponent->RegisterComponent();
-				DynamicMeshComponent->SetComplexAsSimpleCollisionEnabled(true);
-				DynamicMeshComponent->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-				DynamicMeshComponent->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Block);
 
 				FragmentModel->AddInstanceComponent(DynamicMeshComponent);
 			}
+			else if (Instancing)
+			{
+				AddSampleInstance(*Instancing, Sample, LocalTransform * ItemToInstancingRoot, InFragmentItem, MeshesRef, FragmentModel->GetModelGuid(), bSaveMeshes);
+			}
 			else
 			{
-
-				UStaticMesh* Mesh = nullptr;
-				if (MeshCache.Contains(SamplePath))
-				{
-					Mesh = MeshCache[SamplePath];
-				}
-				else
-				{
-					Mesh = LoadObject<UStaticMesh>(nullptr, *SamplePath);
-
-#if WITH_EDITOR
-					if (!Mesh)
-					{
-						UPackage* MeshPackage = CreatePackage(*PackagePath);
-						if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
-						{
-							const auto* shell = MeshesRef->shells()->Get(representation->id());
-							Mesh = CreateStaticMeshFromShell(shell, material, *MeshName, MeshPackage, FragmentModel->GetModelGuid());
-
-						}
-						else if (representation->representation_class() == RepresentationClass_CIRCLE_EXTRUSION)
-						{
-							const auto* circleExtrusion = MeshesRef->circle_extrusions()->Get(representation->id());
-							Mesh = CreateStaticMeshFromCircleExtrusion(circleExtrusion, material, *MeshName, MeshPackage, FragmentModel->GetModelGuid());
-						}
-
-						if (Mesh)
-						{
-							if (!FPaths::FileExists(PackageFileName) && bSaveMeshes)
-							{
-								MeshPackage->FullyLoad();
-	
-								Mesh->Rename(*MeshName, MeshPackage);
-								Mesh->SetFlags(RF_Public | RF_Standalone);
-								MeshPackage->MarkPackageDirty();
-								FAssetRegistryModule::AssetCreated(Mesh);
-	
-								FSavePackageArgs SaveArgs;
-								SaveArgs.SaveFlags = RF_Public | RF_Standalone;
-	
-								PackagesToSave.Add(MeshPackage);
-								UPackage::SavePackage(MeshPackage, Mesh, *PackageFileName, SaveArgs);
-							}
-						}
-					}
-#else
-					if (!Mesh)
-					{
-						UE_LOG(LogFragments, Error, TEXT("Cooked mesh not found: %s"), *SamplePath);
-						continue;
-					}
-#endif
-					MeshCache.Add(SamplePath, Mesh);
-				}
-
+				UStaticMesh* Mesh = GetRepresentationStaticMesh(representation, material, Sample.GeometryHash, MeshesRef, FragmentModel->GetModelGuid(), bSaveMeshes);
 				if (Mesh)
 				{
 
 					// Add StaticMeshComponent to parent actor
 					UStaticMeshComponent* MeshComp = NewObject<UStaticMeshComponent>(FragmentModel);
 					MeshComp->SetStaticMesh(Mesh);
+					// Meshes are shared per representation, the sample may use the other base material
+					const FFragmentMeshBuildSettings& Settings = GetModelMeshBuildSettings(FragmentModel->GetModelGuid());
+					if (Settings.bUseMaterialPalette)
+					{
+						ApplyPaletteMaterial(MeshComp, material);
+					}
+					SetupComponentCollision(MeshComp, InFragmentItem.Category, Settings);
 					MeshComp->SetRelativeTransform(LocalTransform); // local to parent
 					MeshComp->AttachToComponent(RootSceneComponent, FAttachmentTransformRules::KeepRelativeTransform);
 					MeshComp->RegisterComponent();
@@ -924,253 +2009,659 @@ AFragment* UFragmentsImporter::SpawnFragmentModel(FFragmentItem InFragmentItem,
 		} 
 	}
 
-	if (ModelFragmentsMap.Contains(InFragmentItem.ModelGuid))
+	return FragmentModel;
+}
+
+void UFragmentsImporter::BuildRepresentationMeshes(UFragmentModelWrapper* Wrapper, int32 RootItemIndex, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes, bool bUseDynamicMesh)
+{
+	TArray<FFragmentRepresentationMeshJob> Jobs;
+	CollectRepresentationMeshJobs(Wrapper, RootItemIndex, MeshesRef, InModelGuid, bUseDynamicMesh, Jobs);
+	if (Jobs.Num() == 0) return;
+
+	FDateTime StartTime = FDateTime::Now();
+	GenerateRepresentationMeshes(Jobs, MeshesRef, bUseDynamicMesh, Wrapper->GetMeshBuildSettings(), &Wrapper->GetGeometryCache());
+	UE_LOG(LogFragments, Log, TEXT("Generated %d representation meshes in [%s]s -> %s"), Jobs.Num(), *(FDateTime::Now() - StartTime).ToString(), *InModelGuid);
+
+	for (FFragmentRepresentationMeshJob& Job : Jobs)
 	{
-		ModelFragmentsMap[InFragmentItem.ModelGuid].Fragments.Add(InFragmentItem.LocalId, FragmentModel);
+		FinalizeRepresentationMesh(Job, MeshesRef, InModelGuid, bSaveMeshes, bUseDynamicMesh);
 	}
+}
 
-	// Recursively spawn child fragments
-	for (FFragmentItem* Child : InFragmentItem.FragmentChildren)
+void UFragmentsImporter::CollectRepresentationMeshJobs(const UFragmentModelWrapper* Wrapper, int32 RootItemIndex, const Meshes* MeshesRef, const FString& InModelGuid, bool bUseDynamicMesh, TArray<FFragmentRepresentationMeshJob>& OutJobs, int32 TaskId)
+{
+	if (!MeshesRef || !Wrapper || !Wrapper->GetItems().IsValidIndex(RootItemIndex)) return;
+
+#if !WITH_EDITOR
+	// Static meshes can only be loaded from cooked packages at runtime
+	if (!bUseDynamicMesh) return;
+#endif
+
+	// Walk in spawn order so the first sample's material wins as before
+	const TArray<FFragmentItem>& Items = Wrapper->GetItems();
+	TSet<uint64> SeenKeys;
+	TSet<uint32> SeenRepresentations;
+	TArray<int32> Stack;
+	Stack.Add(RootItemIndex);
+
+	while (Stack.Num() > 0)
 	{
-		SpawnFragmentModel(*Child, FragmentModel, MeshesRef, bSaveMeshes, InWrapperRef, bUseDynamicMesh);
-	}
+		const FFragmentItem* Item = &Items[Stack.Pop()];
 
-	return FragmentModel;
+		for (const FFragmentSample& Sample : Item->Samples)
+		{
+			const Representation* representation = MeshesRef->representations()->Get(Sample.RepresentationIndex);
+			const uint32 repId = representation->id();
+
+			// Dynamic meshes only depend on the geometry, static meshes also on the material
+			const uint64 CacheKey = bUseDynamicMesh ? Sample.GeometryHash : UFragmentsUtils::HashGeometryWithMaterial(Sample.GeometryHash, MeshesRef->materials()->Get(Sample.MaterialIndex), Wrapper->GetMeshBuildSettings());
+			bool bAlreadySeen = false;
+			SeenKeys.Add(CacheKey, &bAlreadySeen);
+			if (!bUseDynamicMesh)
+			{
+				// Static meshes are still one asset per representation
+				bool bRepresentationSeen = false;
+				SeenRepresentations.Add(repId, &bRepresentationSeen);
+				bAlreadySeen |= bRepresentationSeen;
+			}
+			if (bAlreadySeen) continue;
+
+			FString MeshName = FString::Printf(TEXT("rep_%u"), repId);
+			if (bUseDynamicMesh)
+			{
+				if (DynamicMeshByGeometryHash.Contains(Sample.GeometryHash)) continue;
+
+				// Triangulated on a previous launch
+				FDynamicMesh3 CachedMesh;
+				if (Wrapper->GetGeometryCache().Find(Sample.GeometryHash, CachedMesh))
+				{
+					// The cache only keeps positions and triangles
+					if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
+					{
+						ApplyHardEdgeNormals(CachedMesh, Wrapper->GetMeshBuildSettings());
+					}
+					DynamicMeshByGeometryHash.Add(Sample.GeometryHash, MoveTemp(CachedMesh));
+					continue;
+				}
+			}
+			else
+			{
+				const FString SamplePath = TEXT("/Game/Buildings") / InModelGuid / MeshName + TEXT(".") + MeshName;
+				if (MeshCache.Contains(SamplePath)) continue;
+
+				// Same geometry and material already built for another model
+				if (UStaticMesh** Shared = StaticMeshByGeometryHash.Find(CacheKey))
+				{
+					MeshCache.Add(SamplePath, *Shared);
+					continue;
+				}
+
+				// Tasks run in order, the earlier one has built it by the time this one spawns
+				if (TaskId != INDEX_NONE && InFlightStaticMeshes.Contains(CacheKey)) continue;
+
+				if (UStaticMesh* Existing = LoadObject<UStaticMesh>(nullptr, *SamplePath))
+				{
+					MeshCache.Add(SamplePath, Existing);
+					StaticMeshByGeometryHash.Add(CacheKey, Existing);
+					continue;
+				}
+			}
+
+			FFragmentRepresentationMeshJob& Job = OutJobs.AddDefaulted_GetRef();
+			Job.RepresentationRef = representation;
+			Job.MaterialIndex = Sample.MaterialIndex;
+			Job.GeometryHash = Sample.GeometryHash;
+			Job.CacheKey = CacheKey;
+			Job.MeshName = MoveTemp(MeshName);
+
+			if (!bUseDynamicMesh && TaskId != INDEX_NONE)
+			{
+				InFlightStaticMeshes.Add(CacheKey, TaskId);
+			}
+		}
+
+		for (int32 i = Item->ChildIndices.Num() - 1; i >= 0; --i)
+		{
+			Stack.Add(Item->ChildIndices[i]);
+		}
+	}
 }
 
-UStaticMesh* UFragmentsImporter::CreateStaticMeshFromShell(const Shell* ShellRef, const Material* RefMaterial, const FString& AssetName, UObject* OuterRef, const FString& InModelGuid)
+void UFragmentsImporter::GenerateRepresentationMeshes(TArray<FFragmentRepresentationMeshJob>& Jobs, const Meshes* MeshesRef, bool bUseDynamicMesh, const FFragmentMeshBuildSettings& Settings, FFragmentGeometryCache* GeometryCache)
 {
-	// Create StaticMesh object
-	UStaticMesh* StaticMesh = NewObject<UStaticMesh>(OuterRef, FName(*AssetName), RF_Public | RF_Standalone /*| RF_Transient*/);
-	StaticMesh->InitResources();
-	StaticMesh->SetLightingGuid();
+	ParallelFor(Jobs.Num(), [&Jobs, MeshesRef, bUseDynamicMesh, &Settings](int32 JobIndex)
+	{
+		FFragmentRepresentationMeshJob& Job = Jobs[JobIndex];
+		const Representation* representation = Job.RepresentationRef;
 
-	UStaticMeshDescription* StaticMeshDescription = StaticMesh->CreateStaticMeshDescription(OuterRef);
-	FMeshDescription& MeshDescription = StaticMeshDescription->GetMeshDescription();
-	UStaticMesh::FBuildMeshDescriptionsParams MeshParams;
+		if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
+		{
+			const auto* shell = MeshesRef->shells()->Get(representation->id());
+			if (bUseDynamicMesh)
+				Job.DynamicMesh = CreateDynamicMeshFromShell(shell, Settings);
+			else
+			{
+				BuildShellMeshDescription(shell, Job.MeshName, Job.MeshDescription, Settings);
+				BuildShellLods(Job.MeshDescription, UFragmentsUtils::MakeBox(representation->bbox()), Settings, Job.Lods);
+			}
+			Job.bBuilt = true;
+		}
+		else if (representation->representation_class() == RepresentationClass_CIRCLE_EXTRUSION)
+		{
+			const auto* circleExtrusion = MeshesRef->circle_extrusions()->Get(representation->id());
+			if (!circleExtrusion || !circleExtrusion->axes() || circleExtrusion->axes()->size() == 0)
+				return;
+
+			if (bUseDynamicMesh)
+				Job.DynamicMesh = CreateDynamicMeshFromCircleExtrusion(circleExtrusion, Settings);
+			else
+			{
+				BuildFullCircleExtrusion(Job.MeshDescription, circleExtrusion, Settings);
+				BuildCircleExtrusionLods(circleExtrusion, Settings, Job.Lods);
+			}
+			Job.bBuilt = true;
+		}
+	});
+
+	if (!bUseDynamicMesh || !GeometryCache || GeometryCache->GetFilePath().IsEmpty()) return;
+
+	for (const FFragmentRepresentationMeshJob& Job : Jobs)
+	{
+		if (Job.bBuilt)
+			GeometryCache->Add(Job.GeometryHash, Job.DynamicMesh);
+	}
+	GeometryCache->Save();
+}
+
+void UFragmentsImporter::FinalizeRepresentationMesh(FFragmentRepresentationMeshJob& Job, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes, bool bUseDynamicMesh)
+{
+	if (bUseDynamicMesh)
+	{
+		if (Job.bBuilt)
+			DynamicMeshByGeometryHash.Add(Job.GeometryHash, MoveTemp(Job.DynamicMesh));
+		return;
+	}
 
-	//Build Settings
 #if WITH_EDITOR
+	bSaveMaterials = bSaveMeshes;
+
+	const FString PackagePath = TEXT("/Game/Buildings") / InModelGuid / Job.MeshName;
+	const FString SamplePath = PackagePath + TEXT(".") + Job.MeshName;
+
+	UStaticMesh* Mesh = nullptr;
+	UStaticMesh** Shared = StaticMeshByGeometryHash.Find(Job.CacheKey);
+	if (Shared && !MeshCache.Contains(SamplePath))
 	{
-		FStaticMeshSourceModel& SrcModel = StaticMesh->AddSourceModel();
-		SrcModel.BuildSettings.bRecomputeNormals = true;
-		SrcModel.BuildSettings.bRecomputeTangents = true;
-		SrcModel.BuildSettings.bRemoveDegenerates = true;
-		SrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
-		SrcModel.BuildSettings.bBuildReversedIndexBuffer = true;
-		SrcModel.BuildSettings.bUseFullPrecisionUVs = false;
-		SrcModel.BuildSettings.bGenerateLightmapUVs = true;
-		SrcModel.BuildSettings.SrcLightmapIndex = 0;
-		SrcModel.BuildSettings.DstLightmapIndex = 1;
-		SrcModel.BuildSettings.MinLightmapResolution = 64;
-		SrcModel.BuildSettings.bComputeWeightedNormals = true;
+		// Built meanwhile for another model, by a synchronous spawn that doesn't wait for tasks
+		MeshCache.Add(SamplePath, *Shared);
+	}
+	// Built meanwhile by another spawn of this model, creating it again would clash with the existing object
+	else if (Job.bBuilt && !MeshCache.Contains(SamplePath))
+	{
+		FString UniquePackageName = FPackageName::ObjectPathToPackageName(PackagePath);
+		FString PackageFileName = FPackageName::LongPackageNameToFilename(UniquePackageName, FPackageName::GetAssetPackageExtension());
+
+		UPackage* MeshPackage = CreatePackage(*PackagePath);
+		const Material* material = MeshesRef->materials()->Get(Job.MaterialIndex);
+		Mesh = CreateStaticMeshFromDescription(Job.MeshDescription, material, Job.MeshName, MeshPackage, InModelGuid, Job.RepresentationRef->representation_class(), &Job.Lods);
+
+		if (Mesh && bSaveMeshes)
+		{
+			SaveMeshPackage(Mesh, MeshPackage, Job.MeshName, PackageFileName);
+		}
+	}
+	if (Mesh)
+	{
+		MeshCache.Add(SamplePath, Mesh);
+		StaticMeshByGeometryHash.Add(Job.CacheKey, Mesh);
 	}
 #endif
 
-	MeshParams.bBuildSimpleCollision = true;
-	MeshParams.bCommitMeshDescription = true;
-	MeshParams.bMarkPackageDirty = true;
-	MeshParams.bUseHashAsGuid = false;
+	// The descriptions are no longer needed once the asset is built
+	Job.MeshDescription.Empty();
+	Job.Lods.Empty();
+}
 
-#if !WITH_EDITOR
-	MeshParams.bFastBuild = true;
+void UFragmentsImporter::SaveMeshPackage(UStaticMesh* Mesh, UPackage* MeshPackage, const FString& MeshName, const FString& PackageFileName)
+{
+#if WITH_EDITOR
+	if (FPaths::FileExists(PackageFileName)) return;
+
+	MeshPackage->FullyLoad();
+
+	Mesh->Rename(*MeshName, MeshPackage);
+	Mesh->SetFlags(RF_Public | RF_Standalone);
+	MeshPackage->MarkPackageDirty();
+	FAssetRegistryModule::AssetCreated(Mesh);
+
+	FSavePackageArgs SaveArgs;
+	SaveArgs.SaveFlags = RF_Public | RF_Standalone;
+
+	PackagesToSave.Add(MeshPackage);
+	UPackage::SavePackage(MeshPackage, Mesh, *PackageFileName, SaveArgs);
+#endif
+}
+
+UStaticMesh* UFragmentsImporter::GetRepresentationStaticMesh(const Representation* representation, const Material* material, uint64 GeometryHash, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes)
+{
+	FString MeshName = FString::Printf(TEXT("rep_%u"), representation->id());
+	FString PackagePath = TEXT("/Game/Buildings") / InModelGuid / MeshName;
+	const FString SamplePath = PackagePath + TEXT(".") + MeshName;
+
+	if (UStaticMesh** Cached = MeshCache.Find(SamplePath))
+	{
+		return *Cached;
+	}
+
+	// Same geometry and material already built for another model
+	const uint64 CacheKey = UFragmentsUtils::HashGeometryWithMaterial(GeometryHash, material, GetModelMeshBuildSettings(InModelGuid));
+	if (UStaticMesh** Shared = StaticMeshByGeometryHash.Find(CacheKey))
+	{
+		MeshCache.Add(SamplePath, *Shared);
+		return *Shared;
+	}
+
+	UStaticMesh* Mesh = LoadObject<UStaticMesh>(nullptr, *SamplePath);
+
+#if WITH_EDITOR
+	if (!Mesh)
+	{
+		FString UniquePackageName = FPackageName::ObjectPathToPackageName(PackagePath);
+		FString PackageFileName = FPackageName::LongPackageNameToFilename(UniquePackageName, FPackageName::GetAssetPackageExtension());
+
+		UPackage* MeshPackage = CreatePackage(*PackagePath);
+		if (representation->representation_class() == RepresentationClass::RepresentationClass_SHELL)
+		{
+			const auto* shell = MeshesRef->shells()->Get(representation->id());
+			Mesh = CreateStaticMeshFromShell(shell, material, *MeshName, MeshPackage, InModelGuid, UFragmentsUtils::MakeBox(representation->bbox()));
+
+		}
+		else if (representation->representation_class() == RepresentationClass_CIRCLE_EXTRUSION)
+		{
+			const auto* circleExtrusion = MeshesRef->circle_extrusions()->Get(representation->id());
+			Mesh = CreateStaticMeshFromCircleExtrusion(circleExtrusion, material, *MeshName, MeshPackage, InModelGuid);
+		}
+
+		if (Mesh && bSaveMeshes)
+		{
+			SaveMeshPackage(Mesh, MeshPackage, MeshName, PackageFileName);
+		}
+	}
+#else
+	if (!Mesh)
+	{
+		UE_LOG(LogFragments, Error, TEXT("Cooked mesh not found: %s"), *SamplePath);
+		return nullptr;
+	}
 #endif
+	MeshCache.Add(SamplePath, Mesh);
+	if (Mesh)
+	{
+		StaticMeshByGeometryHash.Add(CacheKey, Mesh);
+	}
+
+	return Mesh;
+}
+
+void UFragmentsImporter::AddSampleInstance(FFragmentInstancingContext& Instancing, const FFragmentSample& Sample, const FTransform& InstanceTransform, const FFragmentItem& InFragmentItem, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes)
+{
+	AFragment* Root = Instancing.Root.Get();
+	if (!Root) return;
+
+	// With a palette, samples of every color batch together and only opaque and glass are split
+	const FFragmentMeshBuildSettings& Settings = GetModelMeshBuildSettings(InModelGuid);
+	const bool bMaterialPalette = Settings.bUseMaterialPalette;
+	const Material* material = MeshesRef->materials()->Get(Sample.MaterialIndex);
+	const int32 MaterialKey = bMaterialPalette ? (material->a() < 255 ? 1 : 0) : Sample.MaterialIndex;
+	// Items with and without collision don't share a component
+	const bool bCollision = Settings.WantsCollision(InFragmentItem.Category);
+	const FIntPoint Key(Sample.RepresentationIndex, MaterialKey * 2 + (bCollision ? 1 : 0));
+	UFragmentInstancedMeshComponent* Component = nullptr;
+	if (TWeakObjectPtr<UFragmentInstancedMeshComponent>* Found = Instancing.Components.Find(Key))
+	{
+		Component = Found->Get();
+	}
+
+	if (!Component)
+	{
+		const Representation* representation = MeshesRef->representations()->Get(Sample.RepresentationIndex);
+
+		UStaticMesh* Mesh = GetRepresentationStaticMesh(representation, material, Sample.GeometryHash, MeshesRef, InModelGuid, bSaveMeshes);
+		if (!Mesh) return;
+
+		Component = NewObject<UFragmentInstancedMeshComponent>(Root);
+		Component->SetModelGuid(InModelGuid);
+		Component->SetStaticMesh(Mesh);
+		if (bMaterialPalette)
+		{
+			Component->EnableInstanceColors();
+		}
+
+		// Meshes are shared per representation, the material of this batch may differ from the one baked in the mesh
+		if (UMaterialInterface* MaterialInterface = GetOrCreateMaterial(material, InModelGuid, Component))
+		{
+			Component->SetMaterial(0, MaterialInterface);
+		}
+
+		SetupComponentCollision(Component, InFragmentItem.Category, Settings);
+		Component->AttachToComponent(Root->GetRootComponent(), FAttachmentTransformRules::KeepRelativeTransform);
+		Component->RegisterComponent();
+		Root->AddInstanceComponent(Component);
+		Instancing.Components.Add(Key, Component);
+	}
+
+	Component->QueueFragmentInstance(InstanceTransform, InFragmentItem.LocalId, UFragmentsUtils::MakeColor(material));
+}
+
+void UFragmentsImporter::AddItemInstances(FFragmentInstancingContext& Instancing, const FFragmentItem& InFragmentItem, const FTransform& ItemToInstancingRoot, const Meshes* MeshesRef, bool bSaveMeshes)
+{
+	for (const FFragmentSample& Sample : InFragmentItem.Samples)
+	{
+		const Transform* local_transform = MeshesRef->local_transforms()->Get(Sample.LocalTransformIndex);
+		const FTransform LocalTransform = UFragmentsUtils::MakeTransform(local_transform);
+
+		AddSampleInstance(Instancing, Sample, LocalTransform * ItemToInstancingRoot, InFragmentItem, MeshesRef, InFragmentItem.ModelGuid, bSaveMeshes);
+	}
+}
+
+void UFragmentsImporter::FlushSampleInstances(FFragmentInstancingContext& Instancing)
+{
+	for (TPair<FIntPoint, TWeakObjectPtr<UFragmentInstancedMeshComponent>>& Pair : Instancing.Components)
+	{
+		if (UFragmentInstancedMeshComponent* Component = Pair.Value.Get())
+		{
+			Component->FlushFragmentInstances();
+		}
+	}
+}
+
+UStaticMesh* UFragmentsImporter::CreateStaticMeshFromShell(const Shell* ShellRef, const Material* RefMaterial, const FString& AssetName, UObject* OuterRef, const FString& InModelGuid, const FBox& Bounds)
+{
+	const FFragmentMeshBuildSettings& Settings = GetModelMeshBuildSettings(InModelGuid);
+	FMeshDescription MeshDescription;
+	BuildShellMeshDescription(ShellRef, AssetName, MeshDescription, Settings);
+
+	TArray<FFragmentMeshLod> Lods;
+	BuildShellLods(MeshDescription, Bounds, Settings, Lods);
+
+	return CreateStaticMeshFromDescription(MeshDescription, RefMaterial, AssetName, OuterRef, InModelGuid, RepresentationClass::RepresentationClass_SHELL, &Lods);
+}
+
+void UFragmentsImporter::BuildShellMeshDescription(const Shell* ShellRef, const FString& AssetName, FMeshDescription& MeshDescription, const FFragmentMeshBuildSettings& Settings)
+{
+	FStaticMeshAttributes Attributes(MeshDescription);
+	Attributes.Register();
+	TVertexAttributesRef<FVector3f> VertexPositions = Attributes.GetVertexPositions();
 
-	// Convert Shell Geometry (vertices and triangles)
 	const auto* Points = ShellRef->points();
-	TArray<FVector> PointsRef;
-	TArray<FVertexID> Vertices;
-	Vertices.Reserve(Points->size());
+	const auto* Profiles = ShellRef->profiles();
+	const auto* Holes = ShellRef->holes();
 
+	// Shell points in Unreal space, also the input of the triangulation
+	TArray<FVector> PointsRef;
+	PointsRef.SetNumUninitialized(Points->size());
 	for (flatbuffers::uoffset_t i = 0; i < Points->size(); i++)
 	{
 		const auto& P = *Points->Get(i);
-		const FVertexID VertId = StaticMeshDescription->CreateVertex();
-		StaticMeshDescription->SetVertexPosition(VertId, FVector(P.x()*100, P.z()*100, P.y()*100)); // Fix Z-up, and Unreal Units from m to cm
-		PointsRef.Add(FVector(P.x() * 100, P.z() * 100, P.y() * 100));
-		Vertices.Add(VertId);
-
-		//UE_LOG(LogTemp, Log, TEXT("\t\t\t\tpoint %d: x: %f, y:%f, z:%f"), i, P.x(), P.y(), P.z());
+		PointsRef[i] = FVector(P.x() * 100, P.z() * 100, P.y() * 100); // Fix Z-up, and Unreal Units from m to cm
 	}
 
-	FName MaterialSlotName = AddMaterialToMesh(StaticMesh, RefMaterial, InModelGuid);
-	const FPolygonGroupID PolygonGroupId = StaticMeshDescription->CreatePolygonGroup();
-	StaticMeshDescription->SetPolygonGroupMaterialSlotName(PolygonGroupId, MaterialSlotName);
-
 	// Map the holes and identify the profiles that has holes
-	const auto* Holes = ShellRef->holes();
 	TMap<int32, TArray<TArray<int32>>> ProfileHolesIdx;
 	for (flatbuffers::uoffset_t j = 0; j < Holes->size(); j++)
 	{
 		const auto* Hole = Holes->Get(j);
 		const auto* HoleIndices = Hole->indices();
-		const auto Profile_id = Hole->profile_id();
-		TArray<int32> HoleIdx;
 
+		TArray<int32>& HoleIdx = ProfileHolesIdx.FindOrAdd(Hole->profile_id()).AddDefaulted_GetRef();
+		HoleIdx.Reserve(HoleIndices->size());
 		for (flatbuffers::uoffset_t k = 0; k < HoleIndices->size(); k++)
 		{
-			HoleIdx.Add(HoleIndices->Get(k));
+			HoleIdx.Add(HoleIndices->Get(k));
+		}
+	}
+
+	// Triangulate the profiles with holes first, so every element count is known before the description grows
+	struct FTriangulatedProfile
+	{
+		TArray<FVector> Vertices;
+		TArray<int32> Indices;
+		TArray<int32> SourcePoints;
+	};
+	TMap<int32, FTriangulatedProfile> TriangulatedProfiles;
+	FFragmentTriangulator Triangulator;
+	const bool bWeld = Settings.bWeldShellVertices;
+
+	int32 NumVertices = PointsRef.Num();
+	int32 NumCorners = 0;
+	int32 NumTriangles = 0;
+	int32 NumPolygons = 0;
+
+	for (flatbuffers::uoffset_t i = 0; i < Profiles->size(); i++)
+	{
+		const auto* Indices = Profiles->Get(i)->indices();
+		const int32 NumIndices = Indices->size();
+
+		const TArray<TArray<int32>>* ProfileHoles = ProfileHolesIdx.Find(i);
+		if (!ProfileHoles)
+		{
+			NumCorners += NumIndices;
+			NumTriangles += FMath::Max(NumIndices - 2, 0);
+			NumPolygons++;
+			continue;
 		}
 
-		if (ProfileHolesIdx.Contains(Profile_id))
+		if (NumIndices < 3)
 		{
-			ProfileHolesIdx[Profile_id].Add(HoleIdx);
+			UE_LOG(LogFragments, Error, TEXT("Profile %d skipped: fewer than 3 points"), i);
+			continue;
 		}
-		else
+
+		TArray<int32> ProfilePointsIndex;
+		ProfilePointsIndex.Reserve(NumIndices);
+		for (int32 j = 0; j < NumIndices; j++)
 		{
-			TArray<TArray<int32>> HolesForProfile;
-			HolesForProfile.Add(HoleIdx);
-			ProfileHolesIdx.Add(Profile_id, HolesForProfile);
+			ProfilePointsIndex.Add(Indices->Get(j));
 		}
-	}
-	// Create Faces (triangles)
-	const auto* Profiles = ShellRef->profiles();
-	TMap<int32, FPolygonID> PolygonMap;
-	
-	for (flatbuffers::uoffset_t i = 0; i < Profiles->size(); i++)
-	{
-		// Create Profile Polygons for those that has no holes reference
-		//UE_LOG(LogTemp, Log, TEXT("Processing Profile %d"), i);
-		if (!ProfileHolesIdx.Contains(i))
+
+		FTriangulatedProfile Triangulated;
+		if (!Triangulator.Triangulate(PointsRef, ProfilePointsIndex, *ProfileHoles, Triangulated.Vertices, Triangulated.Indices, bWeld ? &Triangulated.SourcePoints : nullptr))
 		{
-			const ShellProfile* Profile = Profiles->Get(i);
-			const auto* Indices = Profile->indices();
+			UE_LOG(LogFragments, Error, TEXT("Profile %d skipped: Triangulation failed"), i);
+			continue;
+		}
 
-			TArray<FVertexInstanceID> VertexInstances;
-			VertexInstances.Reserve(Indices->size());
-			TArray<FVertexInstanceID> TriangleInstance;
-			for (flatbuffers::uoffset_t j = 0; j < Indices->size(); j++)
-			{
-				const auto Indice = Indices->Get(j);
-				if (Vertices.IsValidIndex(Indice))
-				{
-					TriangleInstance.Add(MeshDescription.CreateVertexInstance(Vertices[Indice]));
-				}
-				else
-					UE_LOG(LogFragments, Log, TEXT("Invalid Indice: shell %s, profile %d, indice %d"), *AssetName, i, j);
-			}
+		NumVertices += Triangulated.Vertices.Num();
+		NumCorners += Triangulated.Indices.Num();
+		NumTriangles += Triangulated.Indices.Num() / 3;
+		NumPolygons += Triangulated.Indices.Num() / 3;
+		TriangulatedProfiles.Add(i, MoveTemp(Triangulated));
+	}
 
+	MeshDescription.ReserveNewVertices(NumVertices);
+	MeshDescription.ReserveNewVertexInstances(NumCorners);
+	MeshDescription.ReserveNewEdges(NumCorners);
+	MeshDescription.ReserveNewTriangles(NumTriangles);
+	MeshDescription.ReserveNewPolygons(NumPolygons);
 
-			if (!TriangleInstance.IsEmpty())
-			{
-				FPolygonID PolygonID = MeshDescription.CreatePolygon(PolygonGroupId, TriangleInstance, {});
-			}
-		}
-		// Process profile with holes to create new polygon that fully represent the substraction of holes in profile
-		else
+	// Welded shells share one vertex per position, hard edges are marked below instead
+	FFragmentVertexWelder Welder(Settings.WeldTolerance);
+	auto CreateVertex = [&MeshDescription, &VertexPositions, &Welder, bWeld](const FVector& Position)
 		{
-			const ShellProfile* Profile = Profiles->Get(i);
-			const auto* Indices = Profile->indices();
-			if (Indices->size() < 3)
+			if (bWeld)
 			{
-				UE_LOG(LogFragments, Error, TEXT("Profile %d skipped: fewer than 3 points"), i);
-				continue;
+				const int32 Found = Welder.Find(Position);
+				if (Found != INDEX_NONE) return FVertexID(Found);
 			}
 
-			TArray<FVector> ProfilePoints;
-			TArray<int32> ProfilePointsIndex;
-			for (flatbuffers::uoffset_t j = 0; j < Indices->size(); j++)
+			const FVertexID VertexId = MeshDescription.CreateVertex();
+			VertexPositions[VertexId] = FVector3f(Position);
+			if (bWeld)
 			{
-				const auto Indice = Indices->Get(j);
-				ProfilePointsIndex.Add(Indice);
-				const auto* Point = Points->Get(Indice);
-				FVector Vector = FVector(Point->x() * 100, Point->y() * 100, Point->z() * 100);
-				ProfilePoints.Add(Vector);
+				Welder.Add(Position, VertexId.GetValue());
 			}
+			return VertexId;
+		};
 
-			TArray<TArray<FVector>> ProfileHolesPoints;
+	TArray<FVertexID> Vertices;
+	Vertices.SetNumUninitialized(PointsRef.Num());
+	for (int32 i = 0; i < PointsRef.Num(); i++)
+	{
+		Vertices[i] = CreateVertex(PointsRef[i]);
+	}
 
-			/*UE_LOG(LogTemp, Log, TEXT("Profile %d has %d points and %d holes"),
-				i, Indices->size(), ProfileHolesIdx.Contains(i) ? ProfileHolesIdx[i].Num() : 0);*/
+	// The material slot name is assigned when the static mesh is created on the game thread
+	const FPolygonGroupID PolygonGroupId = MeshDescription.CreatePolygonGroup();
 
-			TArray<int32> OutIndices;
-			TArray<FVector> OutVertices;
-			if (!TriangulatePolygonWithHoles(PointsRef, ProfilePointsIndex, ProfileHolesIdx[i], OutVertices, OutIndices))
+	// Create Faces (triangles)
+	TArray<FVertexInstanceID, TInlineAllocator<16>> PolygonInstances;
+	TArray<FVertexID> ProfileVertices;
+	for (flatbuffers::uoffset_t i = 0; i < Profiles->size(); i++)
+	{
+		// Profiles with holes become the triangles of the substraction of their holes
+		if (const FTriangulatedProfile* Triangulated = TriangulatedProfiles.Find(i))
+		{
+			ProfileVertices.SetNumUninitialized(Triangulated->Vertices.Num(), EAllowShrinking::No);
+			for (int32 j = 0; j < Triangulated->Vertices.Num(); j++)
 			{
-				UE_LOG(LogFragments, Error, TEXT("Profile %d skipped: Triangulation failed"), i);
-				continue;
+				const int32 SourcePoint = bWeld ? Triangulated->SourcePoints[j] : INDEX_NONE;
+				ProfileVertices[j] = SourcePoint != INDEX_NONE ? Vertices[SourcePoint] : CreateVertex(Triangulated->Vertices[j]);
 			}
 
-			TMap<int32, FVertexID> TempVertexMap;
-			for (int32 j = 0; j < OutVertices.Num(); j++)
+			for (int32 j = 0; j + 2 < Triangulated->Indices.Num(); j += 3)
 			{
-				FVertexID VId = StaticMeshDescription->CreateVertex();
-				StaticMeshDescription->SetVertexPosition(VId, OutVertices[j]);
-				TempVertexMap.Add(j, VId);
+				const FVertexID A = ProfileVertices[Triangulated->Indices[j]];
+				const FVertexID B = ProfileVertices[Triangulated->Indices[j + 1]];
+				const FVertexID C = ProfileVertices[Triangulated->Indices[j + 2]];
+				if (A == B || B == C || C == A) continue; // collapsed by welding
+
+				const FVertexInstanceID Triangle[3] = {
+					MeshDescription.CreateVertexInstance(ProfileVertices[Triangulated->Indices[j]]),
+					MeshDescription.CreateVertexInstance(ProfileVertices[Triangulated->Indices[j + 1]]),
+					MeshDescription.CreateVertexInstance(ProfileVertices[Triangulated->Indices[j + 2]])
+				};
+				MeshDescription.CreateTriangle(PolygonGroupId, Triangle);
 			}
+			continue;
+		}
 
-			for (int32 j = 0; j < OutIndices.Num(); j+=3)
-			{
-				TArray<FVertexInstanceID> Triangle;
+		// Skipped above
+		if (ProfileHolesIdx.Contains(i)) continue;
 
-				Triangle.Add(MeshDescription.CreateVertexInstance(TempVertexMap[OutIndices[j]]));
-				Triangle.Add(MeshDescription.CreateVertexInstance(TempVertexMap[OutIndices[j+1]]));
-				Triangle.Add(MeshDescription.CreateVertexInstance(TempVertexMap[OutIndices[j+2]]));
-				
-				if (!Triangle.IsEmpty())
-					MeshDescription.CreatePolygon(PolygonGroupId, Triangle);
+		const auto* Indices = Profiles->Get(i)->indices();
+		PolygonInstances.Reset();
+		for (flatbuffers::uoffset_t j = 0; j < Indices->size(); j++)
+		{
+			const auto Indice = Indices->Get(j);
+			if (Vertices.IsValidIndex(Indice))
+			{
+				// Welding may merge consecutive points
+				const FVertexID VertexId = Vertices[Indice];
+				if (bWeld && PolygonInstances.Num() > 0 && MeshDescription.GetVertexInstanceVertex(PolygonInstances.Last()) == VertexId) continue;
+				PolygonInstances.Add(MeshDescription.CreateVertexInstance(VertexId));
 			}
+			else
+				UE_LOG(LogFragments, Log, TEXT("Invalid Indice: shell %s, profile %d, indice %d"), *AssetName, i, j);
+		}
+		if (bWeld && PolygonInstances.Num() > 1 && MeshDescription.GetVertexInstanceVertex(PolygonInstances[0]) == MeshDescription.GetVertexInstanceVertex(PolygonInstances.Last()))
+		{
+			PolygonInstances.Pop();
+		}
 
+		if (PolygonInstances.Num() >= 3)
+		{
+			MeshDescription.CreatePolygon(PolygonGroupId, PolygonInstances);
 		}
 	}
 	
-	FStaticMeshOperations::ComputeTriangleTangentsAndNormals(MeshDescription);
-	FStaticMeshOperations::ComputeTangentsAndNormals(MeshDescription, EComputeNTBsFlags::Normals | EComputeNTBsFlags::Tangents);
+	if (bWeld)
+	{
+		// Edges between faces sharper than HardEdgeAngle, or shared by more than two faces, keep split normals
+		const float MinSmoothDot = FMath::Cos(FMath::DegreesToRadians(Settings.HardEdgeAngle));
+		TEdgeAttributesRef<bool> EdgeHardnesses = Attributes.GetEdgeHardnesses();
+		auto GetTriangleNormal = [&MeshDescription, &VertexPositions](const FTriangleID TriangleId)
+			{
+				const TArrayView<const FVertexID> TriangleVertices = MeshDescription.GetTriangleVertices(TriangleId);
+				const FVector3f P0 = VertexPositions[TriangleVertices[0]];
+				return FVector3f::CrossProduct(VertexPositions[TriangleVertices[2]] - P0, VertexPositions[TriangleVertices[1]] - P0).GetSafeNormal();
+			};
 
-	StaticMesh->BuildFromMeshDescriptions(TArray<const FMeshDescription*>{&MeshDescription}, MeshParams);
+		for (const FEdgeID EdgeId : MeshDescription.Edges().GetElementIDs())
+		{
+			const TArrayView<const FTriangleID> EdgeTriangles = MeshDescription.GetEdgeConnectedTriangleIDs(EdgeId);
+			EdgeHardnesses[EdgeId] = EdgeTriangles.Num() != 2 ||
+				FVector3f::DotProduct(GetTriangleNormal(EdgeTriangles[0]), GetTriangleNormal(EdgeTriangles[1])) < MinSmoothDot;
+		}
+	}
 
-	return StaticMesh;
+	ComputeDescriptionNormals(MeshDescription, Settings);
 }
 
-UStaticMesh* UFragmentsImporter::CreateStaticMeshFromCircleExtrusion(const CircleExtrusion* CircleExtrusion, const Material* RefMaterial, const FString& AssetName, UObject* OuterRef, const FString& InModelGuid)
+void UFragmentsImporter::ComputeDescriptionNormals(FMeshDescription& MeshDescription, const FFragmentMeshBuildSettings& Settings)
 {
-	if (!CircleExtrusion || !CircleExtrusion->axes() || CircleExtrusion->axes()->size() == 0)
-		return nullptr;
+	// Vertex normals are averaged from the triangle ones across soft edges, both passes are needed
+	EComputeNTBsFlags Flags = EComputeNTBsFlags::Normals;
+	if (Settings.bComputeTangents) Flags |= EComputeNTBsFlags::Tangents;
+	if (Settings.bComputeWeightedNormals) Flags |= EComputeNTBsFlags::WeightedNTBs;
+
+	FStaticMeshOperations::ComputeTriangleTangentsAndNormals(MeshDescription);
+	FStaticMeshOperations::ComputeTangentsAndNormals(MeshDescription, Flags);
+}
+
+UStaticMesh* UFragmentsImporter::CreateStaticMeshFromDescription(FMeshDescription& MeshDescription, const Material* RefMaterial, const FString& AssetName, UObject* OuterRef, const FString& InModelGuid, RepresentationClass InRepresentationClass, TArray<FFragmentMeshLod>* Lods)
+{
+	const bool bIsShell = InRepresentationClass == RepresentationClass::RepresentationClass_SHELL;
+	const FFragmentMeshBuildSettings& Settings = GetModelMeshBuildSettings(InModelGuid);
 
-	UStaticMesh* StaticMesh = NewObject<UStaticMesh>(OuterRef, FName(*AssetName), RF_Public | RF_Standalone | RF_Transient);
+	// Create StaticMesh object
+	const EObjectFlags MeshFlags = bIsShell ? RF_Public | RF_Standalone /*| RF_Transient*/ : RF_Public | RF_Standalone | RF_Transient;
+	UStaticMesh* StaticMesh = NewObject<UStaticMesh>(OuterRef, FName(*AssetName), MeshFlags);
 	StaticMesh->InitResources();
 	StaticMesh->SetLightingGuid();
 
-	TArray<const FMeshDescription*> MeshDescriptionPtrs;
+	UStaticMesh::FBuildMeshDescriptionsParams MeshParams;
+
+	TArray<FMeshDescription*> MeshDescriptions;
+	TArray<float> ScreenSizes;
+	MeshDescriptions.Add(&MeshDescription);
+	ScreenSizes.Add(1.0f);
+	if (Lods)
+	{
+		for (FFragmentMeshLod& Lod : *Lods)
+		{
+			if (MeshDescriptions.Num() == MAX_STATIC_MESH_LODS) break;
+			MeshDescriptions.Add(&Lod.MeshDescription);
+			ScreenSizes.Add(Lod.ScreenSize);
+		}
+	}
 
 	//Build Settings
 #if WITH_EDITOR
+	StaticMesh->bAutoComputeLODScreenSize = false;
+	for (int32 LodIndex = 0; LodIndex < MeshDescriptions.Num(); LodIndex++)
 	{
 		FStaticMeshSourceModel& SrcModel = StaticMesh->AddSourceModel();
-		SrcModel.BuildSettings.bRecomputeNormals = true;
-		SrcModel.BuildSettings.bRecomputeTangents = true;
+		SrcModel.ScreenSize = ScreenSizes[LodIndex];
+		// BuildFromMeshDescriptions renders the description normals as they are, see ComputeDescriptionNormals.
+		// These keep them the same when the saved asset is rebuilt from its source model.
+		SrcModel.BuildSettings.bRecomputeNormals = Settings.bComputeWeightedNormals;
+		SrcModel.BuildSettings.bRecomputeTangents = Settings.bComputeWeightedNormals && Settings.bComputeTangents;
+		SrcModel.BuildSettings.bComputeWeightedNormals = Settings.bComputeWeightedNormals;
 		SrcModel.BuildSettings.bRemoveDegenerates = true;
 		SrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
-		SrcModel.BuildSettings.bBuildReversedIndexBuffer = true;
+		SrcModel.BuildSettings.bBuildReversedIndexBuffer = Settings.bBuildReversedIndexBuffer;
 		SrcModel.BuildSettings.bUseFullPrecisionUVs = false;
-		SrcModel.BuildSettings.bGenerateLightmapUVs = false;
+		SrcModel.BuildSettings.bGenerateLightmapUVs = bIsShell && Settings.bGenerateLightmapUVs;
 		SrcModel.BuildSettings.SrcLightmapIndex = 0;
 		SrcModel.BuildSettings.DstLightmapIndex = 1;
 		SrcModel.BuildSettings.MinLightmapResolution = 64;
-		SrcModel.BuildSettings.bComputeWeightedNormals = true;
 	}
 #endif
 
-	// LOD0 – Full circle extrusion
-	UStaticMeshDescription* LOD0Desc = StaticMesh->CreateStaticMeshDescription(OuterRef);
-	BuildFullCircleExtrusion(*LOD0Desc, CircleExtrusion, RefMaterial, StaticMesh, InModelGuid);
-	MeshDescriptionPtrs.Add(&LOD0Desc->GetMeshDescription());
-
-	{ // To Do: Implementation of LOD for Static Mesh Created. Seaking for better Performance??
-		// LOD1 – Line representation
-		//UStaticMeshDescription* LOD1Desc = StaticMesh->CreateStaticMeshDescription(OwnerRef);
-		//BuildLineOnlyMesh(*LOD1Desc, CircleExtrusion);
-		//MeshDescriptionPtrs.Add(&LOD1Desc->GetMeshDescription());
-
-		//// LOD2 – Empty mesh
-		//UStaticMeshDescription* LOD2Desc = StaticMesh->CreateStaticMeshDescription(OwnerRef);
-		////BuildEmptyMesh(*LOD2Desc);
-		//MeshDescriptionPtrs.Add(&LOD2Desc->GetMeshDescription());
-	}
-
-	// Build mesh
-	UStaticMesh::FBuildMeshDescriptionsParams MeshParams;
-	MeshParams.bBuildSimpleCollision = true;
+	// The body setup is filled below and only cooked once a component needs it
+	MeshParams.bBuildSimpleCollision = false;
+	// Complex collision is cooked from the render data, which cooked builds otherwise drop from the CPU
+	MeshParams.bAllowCpuAccess = Settings.CollisionMode == EFragmentCollisionMode::ComplexAsSimple;
 	MeshParams.bCommitMeshDescription = true;
 	MeshParams.bMarkPackageDirty = true;
 	MeshParams.bUseHashAsGuid = false;
@@ -1179,23 +2670,80 @@ UStaticMesh* UFragmentsImporter::CreateStaticMeshFromCircleExtrusion(const Circl
 	MeshParams.bFastBuild = true;
 #endif
 
-	StaticMesh->BuildFromMeshDescriptions(MeshDescriptionPtrs, MeshParams);
-
-	// THIS IS EDITOR ONLY. TO DO: Find the way to make it in Runtime??
-	//if (StaticMesh->GetNumSourceModels() >= 3)
-	//{
-	//	StaticMesh->GetSourceModel(0).ScreenSize.Default = 1.0f;
-	//	StaticMesh->GetSourceModel(1).ScreenSize.Default = 0.5f;
-	//	StaticMesh->GetSourceModel(2).ScreenSize.Default = 0.1f;
-	//}
-	//else
-	//{
-	//	UE_LOG(LogTemp, Warning, TEXT("Unexpected: Only %d LODs were created!"), StaticMesh->GetNumSourceModels());
-	//}
+	FName MaterialSlotName = AddMaterialToMesh(StaticMesh, RefMaterial, InModelGuid);
+	for (FMeshDescription* LodDescription : MeshDescriptions)
+	{
+		FStaticMeshAttributes Attributes(*LodDescription);
+		TPolygonGroupAttributesRef<FName> SlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+		for (const FPolygonGroupID PolygonGroupId : LodDescription->PolygonGroups().GetElementIDs())
+		{
+			SlotNames[PolygonGroupId] = MaterialSlotName;
+		}
+	}
+
+	StaticMesh->BuildFromMeshDescriptions(TArray<const FMeshDescription*>(MeshDescriptions), MeshParams);
+
+	// Runtime builds have no source models, the render data carries the screen sizes
+	if (FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData())
+	{
+		for (int32 LodIndex = 0; LodIndex < ScreenSizes.Num(); LodIndex++)
+		{
+			RenderData->ScreenSize[LodIndex].Default = ScreenSizes[LodIndex];
+		}
+	}
+
+	StaticMesh->CreateBodySetup();
+	if (UBodySetup* BodySetup = StaticMesh->GetBodySetup())
+	{
+		BodySetup->AggGeom.EmptyElements();
+		switch (Settings.CollisionMode)
+		{
+		case EFragmentCollisionMode::None:
+			BodySetup->CollisionTraceFlag = ECollisionTraceFlag::CTF_UseSimpleAsComplex;
+			BodySetup->bNeverNeedsCookedCollisionData = true;
+			break;
+		case EFragmentCollisionMode::ComplexAsSimple:
+			BodySetup->CollisionTraceFlag = ECollisionTraceFlag::CTF_UseComplexAsSimple;
+			break;
+		default:
+		{
+			TArray<FVector> Points;
+			FStaticMeshConstAttributes Attributes(MeshDescription);
+			TVertexAttributesConstRef<FVector3f> VertexPositions = Attributes.GetVertexPositions();
+			Points.Reserve(MeshDescription.Vertices().Num());
+			for (const FVertexID VertexId : MeshDescription.Vertices().GetElementIDs())
+			{
+				Points.Add(FVector(VertexPositions[VertexId]));
+			}
+			BodySetup->AggGeom = MakeSimpleCollision(Settings.CollisionMode, Points);
+			BodySetup->CollisionTraceFlag = ECollisionTraceFlag::CTF_UseSimpleAsComplex;
+			break;
+		}
+		}
+	}
+
 	return StaticMesh;
 }
 
-FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromShell(const Shell* ShellRef, const Material* RefMaterial, const FString& AssetName, UObject* OuterRef)
+UStaticMesh* UFragmentsImporter::CreateStaticMeshFromCircleExtrusion(const CircleExtrusion* CircleExtrusion, const Material* RefMaterial, const FString& AssetName, UObject* OuterRef, const FString& InModelGuid)
+{
+	if (!CircleExtrusion || !CircleExtrusion->axes() || CircleExtrusion->axes()->size() == 0)
+		return nullptr;
+
+	const FFragmentMeshBuildSettings& Settings = GetModelMeshBuildSettings(InModelGuid);
+
+	// LOD0 – Full circle extrusion
+	FMeshDescription MeshDescription;
+	BuildFullCircleExtrusion(MeshDescription, CircleExtrusion, Settings);
+
+	// LOD1 onwards – Reduced rings
+	TArray<FFragmentMeshLod> Lods;
+	BuildCircleExtrusionLods(CircleExtrusion, Settings, Lods);
+
+	return CreateStaticMeshFromDescription(MeshDescription, RefMaterial, AssetName, OuterRef, InModelGuid, RepresentationClass::RepresentationClass_CIRCLE_EXTRUSION, &Lods);
+}
+
+FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromShell(const Shell* ShellRef, const FFragmentMeshBuildSettings& Settings)
 {
 	TArray<FVector> ShellPoints;
 	{
@@ -1230,7 +2778,26 @@ FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromShell(const Shell* ShellR
 
 	// 3) Create an empty dynamic mesh and begin filling
 	FDynamicMesh3 DynamicMesh;
-	//DynamicMesh.staticme.EnableCompactCopyOnWrite();  // optional perf tweak
+	FFragmentTriangulator Triangulator;
+
+	// Welded meshes share one vertex per shell point, other vertices are matched by position
+	const bool bWeld = Settings.bWeldShellVertices;
+	FFragmentVertexWelder Welder(Settings.WeldTolerance);
+	TArray<int32> ShellPointVertices;
+	ShellPointVertices.Init(INDEX_NONE, bWeld ? ShellPoints.Num() : 0);
+	TArray<int32> SourcePoints;
+
+	auto GetWeldedVertex = [&DynamicMesh, &Welder](const FVector& Position)
+		{
+			int32 VertexId = Welder.Find(Position);
+			if (VertexId == INDEX_NONE)
+			{
+				VertexId = DynamicMesh.AppendVertex(Position);
+				Welder.Add(Position, VertexId);
+			}
+			return VertexId;
+		};
+
 	const auto* ProfilesFB = ShellRef->profiles();
 	for (flatbuffers::uoffset_t pi = 0; pi < ProfilesFB->size(); ++pi)
 	{
@@ -1253,19 +2820,21 @@ FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromShell(const Shell* ShellR
 		}
 
 		// 3b) fetch any hole loops (could be empty)
-		TArray<TArray<int32>> Holes = ProfileHolesIdx.Contains(pi)
-			? ProfileHolesIdx[pi]
-			: TArray<TArray<int32>>();
+		static const TArray<TArray<int32>> NoHoles;
+		const TArray<TArray<int32>>* FoundHoles = ProfileHolesIdx.Find(pi);
+		const TArray<TArray<int32>>& Holes = FoundHoles ? *FoundHoles : NoHoles;
 
 			// 3c) triangulate
 			TArray<FVector> OutVerts;     // 3D points
 			TArray<int32>  OutIndices;    // flat [i0,i1,i2, i0,i1,i2, …]
-			bool bOK = TriangulatePolygonWithHoles(
+			SourcePoints.Reset();
+			bool bOK = Triangulator.Triangulate(
 				ShellPoints,           // all shell points
 				OuterLoop,             // our profile
 				Holes,                 // holes
 				OutVerts,              // out 3D verts
-				OutIndices);           // out flat triangle list
+				OutIndices,            // out flat triangle list
+				bWeld ? &SourcePoints : nullptr);
 
 			if (!bOK)
 			{
@@ -1279,35 +2848,72 @@ FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromShell(const Shell* ShellR
 			NewVIDs.SetNum(OutVerts.Num());
 			for (int32 v = 0; v < OutVerts.Num(); ++v)
 			{
-				NewVIDs[v] = DynamicMesh.AppendVertex(OutVerts[v]);
+				if (!bWeld)
+				{
+					NewVIDs[v] = DynamicMesh.AppendVertex(OutVerts[v]);
+				}
+				else if (SourcePoints[v] != INDEX_NONE)
+				{
+					int32& ShellVertex = ShellPointVertices[SourcePoints[v]];
+					if (ShellVertex == INDEX_NONE)
+					{
+						ShellVertex = GetWeldedVertex(OutVerts[v]);
+					}
+					NewVIDs[v] = ShellVertex;
+				}
+				else
+				{
+					NewVIDs[v] = GetWeldedVertex(OutVerts[v]);
+				}
 			}
 
 			// 3e) append triangles
-			for (int32 t = 0; t < OutIndices.Num(); t += 3)
+			for (int32 t = 0; t + 2 < OutIndices.Num(); t += 3)
 			{
 				int a = NewVIDs[OutIndices[t + 0]];
 				int b = NewVIDs[OutIndices[t + 1]];
 				int c = NewVIDs[OutIndices[t + 2]];
-				DynamicMesh.AppendTriangle(a, b, c);
+				if (a == b || b == c || c == a) continue; // collapsed by welding
+
+				const int TriangleId = DynamicMesh.AppendTriangle(a, b, c);
+				if (TriangleId == FDynamicMesh3::NonManifoldID)
+				{
+					// An edge shared by more than two faces, keep the face on its own vertices
+					DynamicMesh.AppendTriangle(
+						DynamicMesh.AppendVertex(DynamicMesh.GetVertex(a)),
+						DynamicMesh.AppendVertex(DynamicMesh.GetVertex(b)),
+						DynamicMesh.AppendVertex(DynamicMesh.GetVertex(c)));
+				}
 			}
 	}
 
 	// 4) recompute normals & finalize
 	DynamicMesh.CompactCopy(DynamicMesh);
+	ApplyHardEdgeNormals(DynamicMesh, Settings);
 	return DynamicMesh;
 }
 
-FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromCircleExtrusion(const CircleExtrusion* CircleExtrusion, const Material* RefMaterial, const FString& AssetName, UObject* OuterRef)
+void UFragmentsImporter::ApplyHardEdgeNormals(FDynamicMesh3& DynamicMesh, const FFragmentMeshBuildSettings& Settings)
+{
+	// Unwelded meshes have separate vertices per face already
+	if (!Settings.bWeldShellVertices || DynamicMesh.TriangleCount() == 0) return;
+
+	DynamicMesh.EnableAttributes();
+	UE::Geometry::FDynamicMeshNormalOverlay* Normals = DynamicMesh.Attributes()->PrimaryNormals();
+	UE::Geometry::FMeshNormals::InitializeOverlayTopologyFromOpeningAngle(&DynamicMesh, Normals, Settings.HardEdgeAngle);
+	UE::Geometry::FMeshNormals::QuickRecomputeOverlayNormals(DynamicMesh);
+}
+
+FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromCircleExtrusion(const CircleExtrusion* CircleExtrusion, const FFragmentMeshBuildSettings& Settings)
 {
 	if (!CircleExtrusion || !CircleExtrusion->axes() || CircleExtrusion->axes()->size() == 0)
 	{
-		return nullptr;
+		return FDynamicMesh3();
 	}
 	FDynamicMesh3 Mesh;
 	
 	const auto* Axes = CircleExtrusion->axes();
 	const auto* Radii = CircleExtrusion->radius();
-	const int32 SegmentCount = 16;
 
 	for (flatbuffers::uoffset_t axisIndex = 0; axisIndex < Axes->size(); axisIndex++)
 	{
@@ -1328,6 +2934,7 @@ FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromCircleExtrusion(const Cir
 			if (PartIndex == (int)AxisPartClass::AxisPartClass_CIRCLE_CURVE && Curves)
 			{
 				const float Radius = Radii->Get(axisIndex) * 100.0f;
+				const int32 SegmentCount = Settings.GetCircleSegmentCount(Radius);
 
 				TArray<FVector> ArcCenters;
 				TArray<FVector> ArcTangents;
@@ -1341,7 +2948,8 @@ FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromCircleExtrusion(const Cir
 					float ApertureRad = FMath::DegreesToRadians(Circle->aperture());
 					float ArcRadius = Circle->radius() * 100.0f;
 
-					int32 ArcDivs = FMath::Clamp(FMath::RoundToInt(ApertureRad * ArcRadius * 0.05f), 4, 32);
+					// The outer side of the bend has the largest chord error
+					const int32 ArcDivs = Settings.GetArcDivisionCount(ArcRadius + Radius, ApertureRad);
 					for (int32 j = 0; j <= ArcDivs; ++j)
 					{
 						float t = static_cast<float>(j) / ArcDivs;
@@ -1431,6 +3039,7 @@ FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromCircleExtrusion(const Cir
 				FVector Direction = (P2 - P1).GetSafeNormal();
 				FVector XDir, YDir;
 				Direction.FindBestAxisVectors(XDir, YDir);
+				const int32 SegmentCount = Settings.GetCircleSegmentCount(Radii->Get(OrderIndex) * 100.0f);
 
 				TArray<int32> Ring1, Ring2;
 
@@ -1477,6 +3086,7 @@ FDynamicMesh3 UFragmentsImporter::CreateDynamicMeshFromCircleExtrusion(const Cir
 
 				if (!Points || Points->size() < 2)
 					continue;
+				const int32 SegmentCount = Settings.GetCircleSegmentCount(Radii->Get(OrderIndex) * 100.0f);
 
 				TArray<TArray<int>> Rings;
 
@@ -1559,6 +3169,17 @@ FName UFragmentsImporter::AddMaterialToMesh(UStaticMesh*& CreatedMesh, const Mat
 {
 	if (!RefMaterial || !CreatedMesh)return FName();
 
+	UMaterialInterface* MaterialInterface = GetOrCreateMaterial(RefMaterial, InModelGuid, CreatedMesh);
+	if (!MaterialInterface) return FName();
+
+	// Add Material
+	return CreatedMesh->AddMaterial(MaterialInterface);
+}
+
+UMaterialInterface* UFragmentsImporter::GetOrCreateMaterial(const Material* RefMaterial, const FString& InModelGuid, UObject* InOuter)
+{
+	if (!RefMaterial) return nullptr;
+
 	bool HasTransparency = false;
 	float R = RefMaterial->r() / 255.f;
 	float G = RefMaterial->g() / 255.f;
@@ -1579,7 +3200,13 @@ FName UFragmentsImporter::AddMaterialToMesh(UStaticMesh*& CreatedMesh, const Mat
 	if (!Material)
 	{
 		UE_LOG(LogFragments, Error, TEXT("Unable to load Base Material"));
-		return FName();
+		return nullptr;
+	}
+
+	// Shared by every mesh, the color is set per component or instance
+	if (GetModelMeshBuildSettings(InModelGuid).bUseMaterialPalette)
+	{
+		return Material;
 	}
 
 #if WITH_EDITOR
@@ -1633,13 +3260,13 @@ FName UFragmentsImporter::AddMaterialToMesh(UStaticMesh*& CreatedMesh, const Mat
 		MaterialsCache.Add(SamplePath, MaterialInstance);
 	}
 
-	return CreatedMesh->AddMaterial(MaterialInstance);
+	return MaterialInstance;
 #else
-	UMaterialInstanceDynamic* DynamicMaterial = UMaterialInstanceDynamic::Create(Material, CreatedMesh);
+	UMaterialInstanceDynamic* DynamicMaterial = UMaterialInstanceDynamic::Create(Material, InOuter);
 	if (!DynamicMaterial)
 	{
 		UE_LOG(LogFragments, Error, TEXT("Failed to create dynamic material."));
-		return FName();
+		return nullptr;
 	}
 
 	if (HasTransparency)
@@ -1649,9 +3276,7 @@ FName UFragmentsImporter::AddMaterialToMesh(UStaticMesh*& CreatedMesh, const Mat
 
 	DynamicMaterial->SetVectorParameterValue(TEXT("BaseColor"), FVector4(R, G, B, A));
 
-
-	// Add Material
-	return CreatedMesh->AddMaterial(DynamicMaterial);
+	return DynamicMaterial;
 #endif
 
 }
@@ -1663,6 +3288,12 @@ void UFragmentsImporter::AddMaterialToDynamicMesh(UDynamicMeshComponent* InDynCo
 		return;
 	}
 
+	if (InWrapperRef->GetMeshBuildSettings().bUseMaterialPalette)
+	{
+		ApplyPaletteMaterial(InDynComp, RefMaterial);
+		return;
+	}
+
 	UMaterialInstanceDynamic** FoundMid = InWrapperRef->GetMaterialsMap().Find(InMaterialIndex);
 	UMaterialInstanceDynamic* Mid = nullptr;
 
@@ -1709,172 +3340,33 @@ void UFragmentsImporter::AddMaterialToDynamicMesh(UDynamicMeshComponent* InDynCo
 	InDynComp->SetMaterial(0, Mid);
 }
 
-bool UFragmentsImporter::TriangulatePolygonWithHoles(const TArray<FVector>& Points,
-	const TArray<int32>& Profiles,
-	const TArray<TArray<int32>>& Holes,
-	TArray<FVector>& OutVertices,
-	TArray<int32>& OutIndices)
+void UFragmentsImporter::ApplyPaletteMaterial(UPrimitiveComponent* InComponent, const Material* RefMaterial)
 {
-	TESStesselator* Tess = tessNewTess(nullptr);
-	FPlaneProjection Projection = UFragmentsUtils::BuildProjectionPlane(Points, Profiles);
-	
-	auto AddContour = [&](const TArray<int32>& Indices, bool bIsHole)
-		{
-			TArray<FVector2D> Projected;
-			TArray<float> Contour;
-
-			for (int32 Index : Indices)
-			{
-				FVector2D P2d = Projection.Project(Points[Index]);
-				Projected.Add(P2d);
-			}
-
-			if (Projected.Num() < 3)
-			{
-				UE_LOG(LogFragments, Error, TEXT("Contour has fewer than 3 points, skipping."));
-				return;
-			}
-
-			// Check for colinearity
-			bool bColinear = true;
-			const FVector2D& A = Projected[0];
-
-			for (int i = 1; i < Projected.Num() - 1; ++i)
-			{
-				FVector2D Dir1 = (Projected[i] - A).GetSafeNormal();
-				FVector2D Dir2 = (Projected[i + 1] - Projected[i]).GetSafeNormal();
-				if (!Dir1.Equals(Dir2, 0.001f))
-				{
-					bColinear = false;
-					break;
-				}
-			}
-			if (bColinear)
-			{
-				UE_LOG(LogFragments, Error, TEXT("Contour is colinear in 2D projection, skipping."));
-				return;
-			}
-
-			TArray<FVector2D> UniqueProjected;
-			UniqueProjected.Reserve(Projected.Num());
-
-			for (int32 i = 0; i < Projected.Num(); ++i)
-			{
-				if (i == 0 || !Projected[i].Equals(Projected[i - 1], 0.001))
-				{
-					UniqueProjected.Add(Projected[i]);
-				}
-			}
-			Projected = UniqueProjected;
-
-			/*for (const FVector2D& P : Projected)
-			{
-				UE_LOG(LogTemp, Log, TEXT("\tProjected Point before winding check: X: %.3f, Y: %.3f"), P.X, P.Y);
-			}*/
-
-			// Fix winding
-			bool bClockwise = UFragmentsUtils::IsClockwise(Projected);
-			//UE_LOG(LogTemp, Log, TEXT("Contour winding is %s"), bClockwise ? TEXT("CW") : TEXT("CCW"));
-
-			if (!bIsHole && bClockwise)
-			{
-				Algo::Reverse(Projected); // Outer should be CCW
-			}
-			else if (bIsHole && !bClockwise)
-			{
-				Algo::Reverse(Projected); // Holes should be CW
-			}
-			
-			for (const FVector2D& P : Projected)
-			{
-				Contour.Add(P.X);
-				Contour.Add(P.Y);
-				//UE_LOG(LogTemp, Warning, TEXT("    X: %.6f, Y: %.6f"), P.X, P.Y);
-			}
-
-			tessAddContour(Tess, 2, Contour.GetData(), sizeof(float) * 2, Projected.Num());
-		};
-
-	AddContour(Profiles, false);
-
-	for (const TArray<int32>& Hole : Holes)
-	{
-		AddContour(Hole, true);
-	}
-
-	if (!tessTesselate(Tess, TESS_WINDING_ODD, TESS_POLYGONS, 3, 2, nullptr))
-	{
-		UE_LOG(LogFragments, Error, TEXT("tessTesselate failed."));
-		tessDeleteTess(Tess);
-		return false;
-	}
-
-	const int32 VertexCount = tessGetVertexCount(Tess);
-	const TESSreal* Vertices = tessGetVertices(Tess);
-
-	if (VertexCount == 0)
-	{
-		for (const int32& P : Profiles)
-		{
-			UE_LOG(LogFragments, Warning, TEXT("\tPoints of Vertex 0 X: %.6f, Y: %.6f, Z: %.6f"), Points[P].X, Points[P].Y, Points[P].Z);
-		}
-
-		int32 HoleIdx = 0;
-		for (const auto& H : Holes)
-		{
-			for (const int32& P : H)
-			{
-				UE_LOG(LogFragments, Warning, TEXT("\tPoints of Hole %d 0 X: %.6f, Y: %.6f, Z: %.6f"), HoleIdx, Points[P].X, Points[P].Y, Points[P].Z);
-			}
-			HoleIdx++;
-		}
-	}
-
-	TMap<int32, int32> IndexRemap;
-
-	for (int32 i = 0; i < VertexCount; i++)
-	{
-		FVector2D P2d(Vertices[i * 2], Vertices[i * 2 + 1]);
-		FVector P3d = Projection.Unproject(P2d);
-		IndexRemap.Add(i, OutVertices.Num());
-		OutVertices.Add(P3d);
-	}
-	const int32* Indices = tessGetElements(Tess);
-	const int32 ElementCount = tessGetElementCount(Tess);
-	//UE_LOG(LogTemp, Log, TEXT("Tessellated VertexCount: %d, ElementCount: %d"), VertexCount, ElementCount);
+	if (!RefMaterial || !InComponent) return;
 
-	for (int32 i = 0; i < ElementCount; ++i)
+	const FLinearColor Color = UFragmentsUtils::MakeColor(RefMaterial);
+	UMaterialInterface* BaseMat = (Color.A < 1.0f) ? BaseGlassMaterial : BaseMaterial;
+	if (!BaseMat)
 	{
-		const int32* Poly = &Indices[i * 3];
-		for (int j = 0; j < 3; ++j)
-		{
-			int32 Idx = Poly[j];
-			if (Idx != TESS_UNDEF)
-			{
-				OutIndices.Add(IndexRemap[Idx]);
-			}
-		}
+		UE_LOG(LogFragments, Error, TEXT("Unable to load base material for the material palette"));
+		return;
 	}
 
-	tessDeleteTess(Tess);
-
-	return true;
+	InComponent->SetMaterial(0, BaseMat);
+	InComponent->SetCustomPrimitiveDataVector4(0, FVector4(Color.R, Color.G, Color.B, Color.A));
 }
 
-void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& StaticMeshDescription, const CircleExtrusion* CircleExtrusion, const Material* RefMaterial, UStaticMesh* StaticMesh, const FString& InModelGuid)
+void UFragmentsImporter::BuildFullCircleExtrusion(FMeshDescription& MeshDescription, const CircleExtrusion* CircleExtrusion, const FFragmentMeshBuildSettings& Settings)
 {
-	FStaticMeshAttributes Attributes(StaticMeshDescription.GetMeshDescription());
+	FStaticMeshAttributes Attributes(MeshDescription);
 	Attributes.Register();
+	TVertexAttributesRef<FVector3f> VertexPositions = Attributes.GetVertexPositions();
 
-	FName MaterialSlotName = AddMaterialToMesh(StaticMesh, RefMaterial, InModelGuid);
-	const FPolygonGroupID PolygonGroupId = StaticMeshDescription.CreatePolygonGroup();
-	StaticMeshDescription.SetPolygonGroupMaterialSlotName(PolygonGroupId, MaterialSlotName);
-
-	FMeshDescription& MeshDescription = StaticMeshDescription.GetMeshDescription();
+	// The material slot name is assigned when the static mesh is created on the game thread
+	const FPolygonGroupID PolygonGroupId = MeshDescription.CreatePolygonGroup();
 
 	const auto* Axes = CircleExtrusion->axes();
 	const auto* Radii = CircleExtrusion->radius();
-	int32 SegmentCount = 16;
 
 	for (flatbuffers::uoffset_t axisIndex = 0; axisIndex < Axes->size(); ++axisIndex)
 	{
@@ -1897,6 +3389,7 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 			{
 				const auto* Curves = Axis->circle_curves();
 				const float Radius = Radii->Get(axisIndex) * 100.0f;
+				const int32 SegmentCount = Settings.GetCircleSegmentCount(Radius);
 
 				TArray<FVector> ArcCenters;
 				TArray<FVector> ArcTangents;
@@ -1911,7 +3404,8 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 					float ApertureRad = FMath::DegreesToRadians(Circle->aperture());
 					float ArcRadius = Circle->radius() * 100.0f;
 
-					int32 ArcDivs = FMath::Clamp(FMath::RoundToInt(ApertureRad * ArcRadius * 0.05f), 4, 32);
+					// The outer side of the bend has the largest chord error
+					const int32 ArcDivs = Settings.GetArcDivisionCount(ArcRadius + Radius, ApertureRad);
 					for (int32 j = 0; j <= ArcDivs; ++j)
 					{
 						float t = static_cast<float>(j) / ArcDivs;
@@ -1953,8 +3447,8 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 						FVector Offset = FMath::Cos(Angle) * CurrX + FMath::Sin(Angle) * CurrY;
 						FVector Pos = ArcCenters[k] + Offset * Radius;
 
-						FVertexID V = StaticMeshDescription.CreateVertex();
-						StaticMeshDescription.SetVertexPosition(V, Pos);
+						FVertexID V = MeshDescription.CreateVertex();
+						VertexPositions[V] = FVector3f(Pos);
 						Ring.Add(V);
 					}
 
@@ -2006,6 +3500,7 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 				FVector Direction = (P2 - P1).GetSafeNormal();
 				FVector XDir, YDir;
 				Direction.FindBestAxisVectors(XDir, YDir);
+				const int32 SegmentCount = Settings.GetCircleSegmentCount(Radii->Get(OrderIndex) * 100.0f);
 
 				TArray<FVertexID> Ring1, Ring2;
 
@@ -2016,11 +3511,11 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 					FVector V1 = P1 + Offset * Radii->Get(OrderIndex) * 100.0f;
 					FVector V2 = P2 + Offset * Radii->Get(OrderIndex) * 100.0f;
 
-					FVertexID ID1 = StaticMeshDescription.CreateVertex();
-					FVertexID ID2 = StaticMeshDescription.CreateVertex();
+					FVertexID ID1 = MeshDescription.CreateVertex();
+					FVertexID ID2 = MeshDescription.CreateVertex();
 
-					StaticMeshDescription.SetVertexPosition(ID1, V1);
-					StaticMeshDescription.SetVertexPosition(ID2, V2);
+					VertexPositions[ID1] = FVector3f(V1);
+					VertexPositions[ID2] = FVector3f(V2);
 
 					Ring1.Add(ID1);
 					Ring2.Add(ID2);
@@ -2036,19 +3531,19 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 					FVertexID V11 = Ring2[Next];
 
 					TArray<FVertexInstanceID> Tri1 = {
-						StaticMeshDescription.CreateVertexInstance(V00),
-						StaticMeshDescription.CreateVertexInstance(V01),
-						StaticMeshDescription.CreateVertexInstance(V10)
+						MeshDescription.CreateVertexInstance(V00),
+						MeshDescription.CreateVertexInstance(V01),
+						MeshDescription.CreateVertexInstance(V10)
 					};
 
 					TArray<FVertexInstanceID> Tri2 = {
-						StaticMeshDescription.CreateVertexInstance(V10),
-						StaticMeshDescription.CreateVertexInstance(V01),
-						StaticMeshDescription.CreateVertexInstance(V11)
+						MeshDescription.CreateVertexInstance(V10),
+						MeshDescription.CreateVertexInstance(V01),
+						MeshDescription.CreateVertexInstance(V11)
 					};
 
-					StaticMeshDescription.GetMeshDescription().CreatePolygon(PolygonGroupId, Tri1);
-					StaticMeshDescription.GetMeshDescription().CreatePolygon(PolygonGroupId, Tri2);
+					MeshDescription.CreatePolygon(PolygonGroupId, Tri1);
+					MeshDescription.CreatePolygon(PolygonGroupId, Tri2);
 				}
 
 				return;
@@ -2061,6 +3556,7 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 
 				if (!Points || Points->size() < 2)
 					continue;
+				const int32 SegmentCount = Settings.GetCircleSegmentCount(Radii->Get(OrderIndex) * 100.0f);
 
 				TArray<TArray<FVertexID>> Rings;
 
@@ -2099,8 +3595,8 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 						FVector Offset = FMath::Cos(Angle) * XDir + FMath::Sin(Angle) * YDir;
 						FVector RingPos = Pos + Offset * Radii->Get(OrderIndex) * 100.0f;
 
-						FVertexID Vtx = StaticMeshDescription.CreateVertex();
-						StaticMeshDescription.SetVertexPosition(Vtx, RingPos);
+						FVertexID Vtx = MeshDescription.CreateVertex();
+						VertexPositions[Vtx] = FVector3f(RingPos);
 						Ring.Add(Vtx);
 					}
 
@@ -2140,8 +3636,101 @@ void UFragmentsImporter::BuildFullCircleExtrusion(UStaticMeshDescription& Static
 		}
 	}
 
-	FStaticMeshOperations::ComputeTriangleTangentsAndNormals(StaticMeshDescription.GetMeshDescription());
-	FStaticMeshOperations::ComputeTangentsAndNormals(StaticMeshDescription.GetMeshDescription(), EComputeNTBsFlags::Normals | EComputeNTBsFlags::Tangents);
+	ComputeDescriptionNormals(MeshDescription, Settings);
+}
+
+void UFragmentsImporter::BuildCircleExtrusionLods(const CircleExtrusion* CircleExtrusion, const FFragmentMeshBuildSettings& Settings, TArray<FFragmentMeshLod>& OutLods)
+{
+	if (!Settings.bGenerateLods || !CircleExtrusion || !CircleExtrusion->axes() || CircleExtrusion->axes()->size() == 0) return;
+
+	// A looser chord tolerance at a distance, then a triangular prism following the same axis
+	FFragmentMeshBuildSettings ReducedSettings = Settings;
+	ReducedSettings.ChordTolerance = Settings.ChordTolerance * 8.0f;
+	ReducedSettings.MinCircleSegments = 4;
+	ReducedSettings.MaxCircleSegments = FMath::Max(Settings.MaxCircleSegments / 4, 4);
+
+	FFragmentMeshLod& Reduced = OutLods.AddDefaulted_GetRef();
+	BuildFullCircleExtrusion(Reduced.MeshDescription, CircleExtrusion, ReducedSettings);
+	Reduced.ScreenSize = Settings.ReducedLodScreenSize;
+
+	FFragmentMeshBuildSettings ProxySettings = ReducedSettings;
+	ProxySettings.MinCircleSegments = 3;
+	ProxySettings.MaxCircleSegments = 3;
+
+	FFragmentMeshLod& Proxy = OutLods.AddDefaulted_GetRef();
+	BuildFullCircleExtrusion(Proxy.MeshDescription, CircleExtrusion, ProxySettings);
+	Proxy.ScreenSize = FMath::Min(Settings.ProxyLodScreenSize, Settings.ReducedLodScreenSize);
+}
+
+void UFragmentsImporter::BuildShellLods(const FMeshDescription& MeshDescription, const FBox& Bounds, const FFragmentMeshBuildSettings& Settings, TArray<FFragmentMeshLod>& OutLods)
+{
+	// A box has 12 triangles, smaller shells keep their own geometry
+	if (!Settings.bGenerateLods || MeshDescription.Triangles().Num() <= 12) return;
+
+	FBox ProxyBox = Bounds;
+	if (!ProxyBox.IsValid)
+	{
+		FStaticMeshConstAttributes Attributes(MeshDescription);
+		TVertexAttributesConstRef<FVector3f> VertexPositions = Attributes.GetVertexPositions();
+		for (const FVertexID VertexId : MeshDescription.Vertices().GetElementIDs())
+		{
+			ProxyBox += FVector(VertexPositions[VertexId]);
+		}
+	}
+	if (!ProxyBox.IsValid) return;
+
+	FFragmentMeshLod& Proxy = OutLods.AddDefaulted_GetRef();
+	BuildBoxMeshDescription(ProxyBox, Proxy.MeshDescription, Settings);
+	Proxy.ScreenSize = Settings.ProxyLodScreenSize;
+}
+
+void UFragmentsImporter::BuildBoxMeshDescription(const FBox& Box, FMeshDescription& MeshDescription, const FFragmentMeshBuildSettings& Settings)
+{
+	FStaticMeshAttributes Attributes(MeshDescription);
+	Attributes.Register();
+	TVertexAttributesRef<FVector3f> VertexPositions = Attributes.GetVertexPositions();
+
+	MeshDescription.ReserveNewVertices(24);
+	MeshDescription.ReserveNewVertexInstances(24);
+	MeshDescription.ReserveNewPolygons(6);
+	const FPolygonGroupID PolygonGroupId = MeshDescription.CreatePolygonGroup();
+
+	const FVector Center = Box.GetCenter();
+	const FVector Extent = Box.GetExtent();
+
+	// Every face has its own corners so the normals stay flat
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		FVector U = FVector::ZeroVector;
+		FVector V = FVector::ZeroVector;
+		U[(Axis + 1) % 3] = Extent[(Axis + 1) % 3];
+		V[(Axis + 2) % 3] = Extent[(Axis + 2) % 3];
+
+		for (const double Side : { -1.0, 1.0 })
+		{
+			FVector Normal = FVector::ZeroVector;
+			Normal[Axis] = Side;
+			const FVector FaceCenter = Center + Normal * Extent[Axis];
+
+			FVector Corners[4] = { FaceCenter - U - V, FaceCenter + U - V, FaceCenter + U + V, FaceCenter - U + V };
+			// Wound like the other builders, Cross(P2 - P0, P1 - P0) points out of the box
+			if (FVector::DotProduct(FVector::CrossProduct(Corners[2] - Corners[0], Corners[1] - Corners[0]), Normal) < 0)
+			{
+				Swap(Corners[1], Corners[3]);
+			}
+
+			TArray<FVertexInstanceID, TInlineAllocator<4>> FaceInstances;
+			for (const FVector& Corner : Corners)
+			{
+				const FVertexID VertexId = MeshDescription.CreateVertex();
+				VertexPositions[VertexId] = FVector3f(Corner);
+				FaceInstances.Add(MeshDescription.CreateVertexInstance(VertexId));
+			}
+			MeshDescription.CreatePolygon(PolygonGroupId, FaceInstances);
+		}
+	}
+
+	ComputeDescriptionNormals(MeshDescription, Settings);
 }
 
 void UFragmentsImporter::BuildLineOnlyMesh(UStaticMeshDescription& StaticMeshDescription, const CircleExtrusion* CircleExtrusion)
@@ -16,6 +16,32 @@ FString UFragmentsImporterSubsystem::LoadFragment(const FString& FragPath)
     return ModelGuid;
 }
 
+int32 UFragmentsImporterSubsystem::LoadFragmentAsync(const FString& FragPath, FOnFragmentLoadProgress OnProgress, FOnFragmentLoadCompleted OnCompleted)
+{
+    check(Importer);
+
+    TWeakObjectPtr<UFragmentsImporterSubsystem> WeakThis(this);
+    return Importer->LoadFragmentAsync(FragPath,
+        [OnProgress](int32 RequestId, float Progress)
+        {
+            OnProgress.ExecuteIfBound(RequestId, Progress);
+        },
+        [WeakThis, OnCompleted](int32 RequestId, const FString& ModelGuid)
+        {
+            if (WeakThis.IsValid() && WeakThis->Importer)
+            {
+                WeakThis->FragmentModels = WeakThis->Importer->GetFragmentModels();
+            }
+            OnCompleted.ExecuteIfBound(RequestId, !ModelGuid.IsEmpty(), ModelGuid);
+        });
+}
+
+void UFragmentsImporterSubsystem::CancelLoadFragment(int32 RequestId)
+{
+    if (Importer)
+        Importer->CancelLoadFragment(RequestId);
+}
+
 void UFragmentsImporterSubsystem::UnloadFragment(const FString& ModelGuid)
 {
     if (Importer)
@@ -28,29 +54,78 @@ void UFragmentsImporterSubsystem::UnloadFragment(const FString& ModelGuid)
     }
 }
 
-FString UFragmentsImporterSubsystem::ProcessFragment(AActor* OwnerActor, const FString& FragPath, TArray<class AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh)
+FString UFragmentsImporterSubsystem::ProcessFragment(AActor* OwnerActor, const FString& FragPath, TArray<class AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, EFragmentMeshBuildPreset BuildPreset)
 {
     check(Importer);
 
-    FString ModelGuid = Importer->Process(OwnerActor, FragPath, OutFragments, bSaveMeshes, bUseDynamicMesh);
+    FString ModelGuid = Importer->Process(OwnerActor, FragPath, OutFragments, bSaveMeshes, bUseDynamicMesh, SpawnMode, BuildPreset);
 
     FragmentModels = Importer->GetFragmentModels();
 
     return ModelGuid;
 }
 
-void UFragmentsImporterSubsystem::ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh)
+void UFragmentsImporterSubsystem::ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode)
 {
     check(Importer);
 
-    Importer->ProcessLoadedFragment(InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh);
+    Importer->ProcessLoadedFragment(InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh, SpawnMode);
 }
 
-void UFragmentsImporterSubsystem::ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh)
+void UFragmentsImporterSubsystem::ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode)
 {
     check(Importer);
 
-    return Importer->ProcessLoadedFragmentItem(InLocalId, InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh);
+    return Importer->ProcessLoadedFragmentItem(InLocalId, InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh, SpawnMode);
+}
+
+int32 UFragmentsImporterSubsystem::ProcessLoadedFragmentAsync(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, FOnFragmentSpawnProgress OnProgress, FOnFragmentSpawnCompleted OnCompleted)
+{
+    check(Importer);
+
+    return Importer->ProcessLoadedFragmentAsync(InModelGuid, InOwnerRef, bInSaveMesh, bUseDynamicMesh, SpawnMode,
+        [OnProgress](int32 TaskId, float Progress)
+        {
+            OnProgress.ExecuteIfBound(TaskId, Progress);
+        },
+        [OnCompleted](int32 TaskId, AFragment* RootFragment)
+        {
+            OnCompleted.ExecuteIfBound(TaskId, RootFragment != nullptr, RootFragment);
+        });
+}
+
+void UFragmentsImporterSubsystem::CancelProcessLoadedFragment(int32 TaskId)
+{
+    if (Importer)
+        Importer->CancelProcessLoadedFragment(TaskId);
+}
+
+void UFragmentsImporterSubsystem::SetSpawnBudgetMs(float InBudgetMs)
+{
+    check(Importer);
+
+    Importer->SetSpawnBudgetMs(InBudgetMs);
+}
+
+void UFragmentsImporterSubsystem::SetGeometryCacheDirectory(const FString& InDirectory)
+{
+    check(Importer);
+
+    Importer->SetGeometryCacheDirectory(InDirectory);
+}
+
+void UFragmentsImporterSubsystem::SetUseGeometryCache(bool bInUseGeometryCache)
+{
+    check(Importer);
+
+    Importer->SetUseGeometryCache(bInUseGeometryCache);
+}
+
+void UFragmentsImporterSubsystem::SetMeshBuildSettings(const FFragmentMeshBuildSettings& InSettings)
+{
+    check(Importer);
+
+    Importer->SetMeshBuildSettings(InSettings);
 }
 
 TArray<int32> UFragmentsImporterSubsystem::GetElementsByCategory(const FString& InCategory, const FString& ModelGuid)
@@ -60,6 +135,62 @@ TArray<int32> UFragmentsImporterSubsystem::GetElementsByCategory(const FString&
     return Importer->GetElementsByCategory(InCategory, ModelGuid);
 }
 
+TArray<int32> UFragmentsImporterSubsystem::GetElementsByCategories(const TArray<FString>& InCategories, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsByCategories(InCategories, ModelGuid);
+}
+
+TArray<FFragmentCategoryElements> UFragmentsImporterSubsystem::GetElementsByCategoriesGrouped(const TArray<FString>& InCategories, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsByCategoriesGrouped(InCategories, ModelGuid);
+}
+
+TArray<FString> UFragmentsImporterSubsystem::GetCategories(const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetCategories(ModelGuid);
+}
+
+TArray<int32> UFragmentsImporterSubsystem::GetElementsInBox(const FBox& Box, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsInBox(Box, ModelGuid);
+}
+
+TArray<int32> UFragmentsImporterSubsystem::GetElementsInSphere(const FVector& Center, float Radius, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsInSphere(Center, Radius, ModelGuid);
+}
+
+TArray<int32> UFragmentsImporterSubsystem::GetElementsInFrustum(const FMinimalViewInfo& View, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetElementsInFrustum(View, ModelGuid);
+}
+
+int32 UFragmentsImporterSubsystem::GetNearestElement(const FVector& Point, const FString& ModelGuid)
+{
+    check(Importer);
+
+    return Importer->GetNearestElement(Point, ModelGuid);
+}
+
+bool UFragmentsImporterSubsystem::RaycastFragments(const FVector& Origin, const FVector& Direction, FFragmentRaycastHit& OutHit, float MaxDistance)
+{
+    check(Importer);
+
+    return Importer->RaycastFragments(Origin, Direction, MaxDistance, OutHit);
+}
+
 AFragment* UFragmentsImporterSubsystem::GetItemByLocalId(int32 InLocalId, const FString& InModelGuid)
 {
     check (Importer)
@@ -85,6 +216,12 @@ TArray<FItemAttribute> UFragmentsImporterSubsystem::GetItemPropertySets(int32 Lo
     return Importer->GetItemPropertySets(LocalId, InModelGuid);
 }
 
+TArray<int32> UFragmentsImporterSubsystem::GetRelatedItems(int32 LocalId, const FString& InModelGuid, const FString& RelationName)
+{
+    check(Importer);
+    return Importer->GetRelatedItems(LocalId, InModelGuid, RelationName);
+}
+
 AFragment* UFragmentsImporterSubsystem::GetModelFragment(const FString& InModelGuid)
 {
     check(Importer);
@@ -3,6 +3,21 @@
 
 #include "Utils/FragmentsUtils.h"
 #include "Fragment/Fragment.h"
+#include "Hash/xxhash.h"
+
+namespace
+{
+	template <typename T>
+	void HashVector(FXxHash64Builder& Builder, const flatbuffers::Vector<T>* Vector, SIZE_T ElementSize)
+	{
+		const uint32 Num = Vector ? Vector->size() : 0;
+		Builder.Update(&Num, sizeof(Num));
+		if (Num > 0)
+		{
+			Builder.Update(Vector->Data(), Num * ElementSize);
+		}
+	}
+}
 
 FTransform UFragmentsUtils::MakeTransform(const Transform* FragmentsTransform, bool bIsLocalTransform)
 {
@@ -41,6 +56,23 @@ FTransform UFragmentsUtils::MakeTransform(const Transform* FragmentsTransform, b
 	return OutTransform;
 }
 
+FBox UFragmentsUtils::MakeBox(const BoundingBox& FragmentsBox)
+{
+	const FVector Min = FVector(FragmentsBox.min().x(), FragmentsBox.min().z(), FragmentsBox.min().y()) * 100.0f;
+	const FVector Max = FVector(FragmentsBox.max().x(), FragmentsBox.max().z(), FragmentsBox.max().y()) * 100.0f;
+	if (Min.X > Max.X || Min.Y > Max.Y || Min.Z > Max.Z)
+	{
+		return FBox(ForceInit);
+	}
+	return FBox(Min, Max);
+}
+
+FLinearColor UFragmentsUtils::MakeColor(const Material* MaterialRef)
+{
+	if (!MaterialRef) return FLinearColor::White;
+	return FLinearColor(MaterialRef->r() / 255.f, MaterialRef->g() / 255.f, MaterialRef->b() / 255.f, MaterialRef->a() / 255.f);
+}
+
 FPlaneProjection UFragmentsUtils::BuildProjectionPlane(const TArray<FVector>& Points, const TArray<int32>& Profile)
 {
 	FPlaneProjection Projection;
@@ -172,7 +204,7 @@ AFragment* UFragmentsUtils::MapModelStructure(const SpatialStructure* InS, AFrag
 	return FragmentActor;
 }
 
-void UFragmentsUtils::MapModelStructureToData(const SpatialStructure* InS, FFragmentItem& ParentItem, const FString& InheritedCategory)
+void UFragmentsUtils::MapModelStructureToData(const SpatialStructure* InS, TArray<FFragmentItem>& Items, int32 ParentIndex, const FString& InheritedCategory)
 {
 	// Determine if this node should be stored as a fragment data object
 	const bool bHasLocalId = InS->local_id().has_value();
@@ -182,20 +214,23 @@ void UFragmentsUtils::MapModelStructureToData(const SpatialStructure* InS, FFrag
 	const bool bEffectiveCategory = bHasCategory || !InheritedCategory.IsEmpty();
 	const bool bShouldStore = bHasLocalId && bEffectiveCategory;
 
-	FFragmentItem* FragmentItem = new FFragmentItem();
+	int32 ChildrenParentIndex = ParentIndex;
 	// Only proceed if we need to store the fragment data
 	if (bShouldStore)
 	{
 		// Create a new FFragmentItem
+		const int32 ItemIndex = Items.AddDefaulted();
+		FFragmentItem& FragmentItem = Items[ItemIndex];
 
 		// Populate the fragment item with data from the SpatialStructure
-		FragmentItem->ModelGuid = ParentItem.ModelGuid;
-		FragmentItem->LocalId = InS->local_id().value();
-		FragmentItem->Category = ThisCategory;
+		FragmentItem.ModelGuid = Items[ParentIndex].ModelGuid;
+		FragmentItem.LocalId = InS->local_id().value();
+		FragmentItem.Category = ThisCategory;
+		FragmentItem.ParentIndex = ParentIndex;
 
 		// Store this FragmentItem as a child of the parent fragment item
-		ParentItem.FragmentChildren.Add(FragmentItem);
-
+		Items[ParentIndex].ChildIndices.Add(ItemIndex);
+		ChildrenParentIndex = ItemIndex;
 	}
 
 
@@ -205,7 +240,7 @@ void UFragmentsUtils::MapModelStructureToData(const SpatialStructure* InS, FFrag
 		for (flatbuffers::uoffset_t i = 0; i < InS->children()->size(); i++)
 		{
 			// Recursively add child fragments
-			MapModelStructureToData(InS->children()->Get(i), bShouldStore ? *ParentItem.FragmentChildren.Last() : ParentItem, ThisCategory);
+			MapModelStructureToData(InS->children()->Get(i), Items, ChildrenParentIndex, ThisCategory);
 		}
 	}
 }
@@ -366,3 +401,168 @@ TArray<FItemAttribute> UFragmentsUtils::ParsePropertySets(const TArray<FItemAttr
 
 	return ParsedPropertySets;
 }
+
+uint64 UFragmentsUtils::HashRepresentationGeometry(const Meshes* MeshesRef, const Representation* RepresentationRef, uint32 SettingsHash)
+{
+	if (!MeshesRef || !RepresentationRef) return 0;
+
+	FXxHash64Builder Builder;
+	const int8 Class = RepresentationRef->representation_class();
+	Builder.Update(&Class, sizeof(Class));
+	Builder.Update(&SettingsHash, sizeof(SettingsHash));
+
+	if (Class == RepresentationClass::RepresentationClass_SHELL)
+	{
+		const Shell* ShellRef = MeshesRef->shells()->Get(RepresentationRef->id());
+		if (!ShellRef) return 0;
+
+		HashVector(Builder, ShellRef->points(), sizeof(FloatVector));
+		if (const auto* Profiles = ShellRef->profiles())
+		{
+			for (const ShellProfile* Profile : *Profiles)
+			{
+				HashVector(Builder, Profile->indices(), sizeof(uint16));
+			}
+		}
+		if (const auto* Holes = ShellRef->holes())
+		{
+			for (const ShellHole* Hole : *Holes)
+			{
+				const uint16 ProfileId = Hole->profile_id();
+				Builder.Update(&ProfileId, sizeof(ProfileId));
+				HashVector(Builder, Hole->indices(), sizeof(uint16));
+			}
+		}
+	}
+	else if (Class == RepresentationClass::RepresentationClass_CIRCLE_EXTRUSION)
+	{
+		const CircleExtrusion* CircleExtrusionRef = MeshesRef->circle_extrusions()->Get(RepresentationRef->id());
+		if (!CircleExtrusionRef) return 0;
+
+		HashVector(Builder, CircleExtrusionRef->radius(), sizeof(double));
+		if (const auto* Axes = CircleExtrusionRef->axes())
+		{
+			for (const Axis* AxisRef : *Axes)
+			{
+				HashVector(Builder, AxisRef->wires(), sizeof(Wire));
+				HashVector(Builder, AxisRef->order(), sizeof(uint32));
+				HashVector(Builder, AxisRef->parts(), sizeof(int8));
+				HashVector(Builder, AxisRef->circle_curves(), sizeof(CircleCurve));
+				if (const auto* WireSets = AxisRef->wire_sets())
+				{
+					for (const WireSet* WireSetRef : *WireSets)
+					{
+						HashVector(Builder, WireSetRef->ps(), sizeof(FloatVector));
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		return 0;
+	}
+
+	return Builder.Finalize().Hash;
+}
+
+uint64 UFragmentsUtils::HashGeometryWithMaterial(uint64 GeometryHash, const Material* MaterialRef, const FFragmentMeshBuildSettings& Settings)
+{
+	FXxHash64Builder Builder;
+	Builder.Update(&GeometryHash, sizeof(GeometryHash));
+	// The body setup and build options are baked in the mesh
+	const EFragmentCollisionMode CollisionMode = Settings.CollisionMode;
+	Builder.Update(&CollisionMode, sizeof(CollisionMode));
+	const uint8 BuildFlags = (Settings.bGenerateLightmapUVs ? 1 : 0) | (Settings.bBuildReversedIndexBuffer ? 2 : 0) | (Settings.bComputeTangents ? 4 : 0) | (Settings.bComputeWeightedNormals ? 8 : 0);
+	Builder.Update(&BuildFlags, sizeof(BuildFlags));
+	if (Settings.bUseMaterialPalette)
+	{
+		// Tagged so palette meshes never collide with a mesh baked with a material instance
+		const uint8 PaletteSlot = (MaterialRef && MaterialRef->a() < 255) ? 2 : 1;
+		Builder.Update(&PaletteSlot, sizeof(PaletteSlot));
+	}
+	else if (MaterialRef)
+	{
+		Builder.Update(MaterialRef, sizeof(Material));
+	}
+	return Builder.Finalize().Hash;
+}
+
+int32 FFragmentMeshBuildSettings::GetCircleSegmentCount(double Radius) const
+{
+	const int32 MinSegments = FMath::Max(MinCircleSegments, 3);
+	const int32 MaxSegments = FMath::Max(MaxCircleSegments, MinSegments);
+	if (ChordTolerance <= 0.0f) return MaxSegments;
+	if (Radius <= ChordTolerance) return MinSegments;
+
+	// A segment spanning Angle is at most Radius * (1 - cos(Angle / 2)) away from the circle
+	const double MaxAngle = 2.0 * FMath::Acos(1.0 - ChordTolerance / Radius);
+	return FMath::Clamp(FMath::CeilToInt32(UE_DOUBLE_TWO_PI / MaxAngle), MinSegments, MaxSegments);
+}
+
+int32 FFragmentMeshBuildSettings::GetArcDivisionCount(double Radius, double ApertureRadians) const
+{
+	// Same step as a full ring, without the minimum meant for thin rings
+	const int32 MaxSegments = FMath::Max(MaxCircleSegments, 3);
+	if (ChordTolerance <= 0.0f) return MaxSegments;
+	if (Radius <= ChordTolerance) return 1;
+
+	const double MaxAngle = 2.0 * FMath::Acos(1.0 - ChordTolerance / Radius);
+	return FMath::Clamp(FMath::CeilToInt32(FMath::Abs(ApertureRadians) / MaxAngle), 1, MaxSegments);
+}
+
+void FFragmentMeshBuildSettings::ApplyPreset(EFragmentMeshBuildPreset Preset)
+{
+	switch (Preset)
+	{
+	case EFragmentMeshBuildPreset::Preview:
+		bGenerateLods = false;
+		bComputeTangents = false;
+		bComputeWeightedNormals = false;
+		bGenerateLightmapUVs = false;
+		bBuildReversedIndexBuffer = false;
+		break;
+	case EFragmentMeshBuildPreset::Lumen:
+		bGenerateLods = true;
+		bComputeTangents = true;
+		bComputeWeightedNormals = false;
+		bGenerateLightmapUVs = false;
+		bBuildReversedIndexBuffer = false;
+		break;
+	case EFragmentMeshBuildPreset::Production:
+		bGenerateLods = true;
+		bComputeTangents = true;
+		bComputeWeightedNormals = true;
+		bGenerateLightmapUVs = true;
+		bBuildReversedIndexBuffer = true;
+		break;
+	default:
+		break;
+	}
+}
+
+bool FFragmentMeshBuildSettings::WantsCollision(const FString& Category) const
+{
+	if (CollisionMode == EFragmentCollisionMode::None) return false;
+	return CollisionCategories.Num() == 0 || CollisionCategories.Contains(Category);
+}
+
+uint32 FFragmentMeshBuildSettings::GetSettingsHash() const
+{
+	uint32 Hash = GetTypeHash(bWeldShellVertices);
+	if (bWeldShellVertices)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(WeldTolerance));
+		Hash = HashCombine(Hash, GetTypeHash(HardEdgeAngle));
+	}
+	Hash = HashCombine(Hash, GetTypeHash(bGenerateLods));
+	if (bGenerateLods)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(ReducedLodScreenSize));
+		Hash = HashCombine(Hash, GetTypeHash(ProxyLodScreenSize));
+	}
+	Hash = HashCombine(Hash, GetTypeHash(ChordTolerance));
+	Hash = HashCombine(Hash, GetTypeHash(MinCircleSegments));
+	Hash = HashCombine(Hash, GetTypeHash(MaxCircleSegments));
+	return Hash;
+}
@@ -44,7 +44,7 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Fragments")
 	FString GetGuid() const { return Guid; }
 
-	void SetAttributes(TArray<struct FItemAttribute> InAttributes) { Attributes = InAttributes; }
+	void SetAttributes(const TArray<struct FItemAttribute>& InAttributes) { Attributes = InAttributes; }
 
 	UFUNCTION(BlueprintCallable, Category = "Fragments")
 	TArray<struct FItemAttribute> GetAttributes();
@@ -67,7 +67,7 @@ public:
 	void AddSampleInfo(const struct FFragmentSample& Sample) { Samples.Add(Sample); }
 	void SetGlobalTransform(const FTransform& InGlobalTransform) { GlobalTransform = InGlobalTransform; }
 	FTransform GetGlobalTransform() const { return GlobalTransform; }
-	void SetData(FFragmentItem InFragmentItem);
+	void SetData(const FFragmentItem& InFragmentItem);
 
 protected:
 
@@ -87,9 +87,6 @@ protected:
 	TArray<struct FItemAttribute> Attributes;
 
 private:
-
-	FFragmentItem Data;
-
 	
 	UPROPERTY()
 	TArray<AFragment*> FragmentChildren;
@@ -0,0 +1,54 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "FragmentInstancedMeshComponent.generated.h"
+
+/**
+ * Renders every sample sharing a representation and material as instances of a single component.
+ * Keeps the LocalId of the item behind each instance for picking and property lookup.
+ */
+UCLASS()
+class FRAGMENTSUNREAL_API UFragmentInstancedMeshComponent : public UHierarchicalInstancedStaticMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	UFragmentInstancedMeshComponent();
+
+	// Instances are queued and added in one batch on flush, so the tree is rebuilt once.
+	// InColor is written to custom data 0-3 once EnableInstanceColors was called.
+	void QueueFragmentInstance(const FTransform& InstanceTransform, int32 InLocalId, const FLinearColor& InColor = FLinearColor::White);
+	void FlushFragmentInstances();
+
+	// Instances of different colors share the component, their material reads PerInstanceCustomData 0-3. Call before adding instances.
+	void EnableInstanceColors();
+
+	void SetModelGuid(const FString& InModelGuid) { ModelGuid = InModelGuid; }
+
+	UFUNCTION(BlueprintCallable, Category = "Fragments")
+	FString GetModelGuid() const { return ModelGuid; }
+
+	// Returns the LocalId of the item owning the instance, e.g. FHitResult::Item. INDEX_NONE if out of range.
+	UFUNCTION(BlueprintCallable, Category = "Fragments")
+	int32 GetInstanceLocalId(int32 InstanceIndex) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Fragments")
+	const TArray<int32>& GetInstanceLocalIds() const { return InstanceLocalIds; }
+
+private:
+
+	UPROPERTY()
+	FString ModelGuid;
+
+	// Indexed by instance index
+	UPROPERTY()
+	TArray<int32> InstanceLocalIds;
+
+	TArray<FTransform> PendingTransforms;
+	TArray<int32> PendingLocalIds;
+	TArray<FLinearColor> PendingColors;
+};
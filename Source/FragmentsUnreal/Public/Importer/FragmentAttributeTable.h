@@ -0,0 +1,87 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Index/index_generated.h"
+#include "Utils/FragmentsUtils.h"
+
+enum class EFragmentAttributeType : uint8
+{
+	String,
+	Number,
+	Bool
+};
+
+/**
+ * A property resolved from the attribute rows of a property set and its properties.
+ */
+struct FFragmentPropertyRef
+{
+	int32 PropertySetId = INDEX_NONE;	// Interned property set name, INDEX_NONE if none was seen yet
+	int32 NameRow = INDEX_NONE;			// Row holding the property name as its value
+	int32 ValueRow = INDEX_NONE;		// Row holding the property value
+};
+
+/**
+ * Attributes of every item of a model, parsed once when the model is loaded.
+ * Stored column by column, the rows of one item are contiguous and every string is interned,
+ * so keys and property set names compare by id.
+ */
+class FRAGMENTSUNREAL_API FFragmentAttributeTable
+{
+public:
+
+	// Parses Model::attributes(). Safe to call off the game thread.
+	void Build(const Model* InModel);
+	void Reset();
+
+	// Rows of the item at ItemIndex (index into the model's per-item vectors)
+	int32 GetFirstRow(int32 ItemIndex) const { return ItemRowOffsets.IsValidIndex(ItemIndex + 1) ? ItemRowOffsets[ItemIndex] : 0; }
+	int32 GetNumRows(int32 ItemIndex) const { return ItemRowOffsets.IsValidIndex(ItemIndex + 1) ? ItemRowOffsets[ItemIndex + 1] - ItemRowOffsets[ItemIndex] : 0; }
+	int32 NumRows() const { return KeyIds.Num(); }
+
+	int32 GetKeyId(int32 Row) const { return KeyIds[Row]; }
+	int32 GetValueId(int32 Row) const { return ValueIds[Row]; }
+	const FString& GetKey(int32 Row) const { return Strings[KeyIds[Row]]; }
+	const FString& GetValue(int32 Row) const { return Strings[ValueIds[Row]]; }
+	EFragmentAttributeType GetType(int32 Row) const { return Types[Row]; }
+	double GetNumber(int32 Row) const { return Numbers[Row]; }
+	bool GetBool(int32 Row) const { return Numbers[Row] != 0.0; }
+	int64 GetTypeHash(int32 Row) const { return TypeHashes[Row]; }
+
+	const FString& GetString(int32 StringId) const { return Strings[StringId]; }
+	int32 FindString(const FString& InString) const;
+
+	// Same result as UFragmentsUtils::ParseItemAttribute on the item's raw attribute
+	void GetItemAttributes(int32 ItemIndex, TArray<FItemAttribute>& OutAttributes) const;
+
+	// Same pairing as UFragmentsUtils::ParsePropertySets, on rows in the order they were collected
+	void ResolvePropertySets(TConstArrayView<int32> Rows, TArray<FFragmentPropertyRef>& OutProperties) const;
+	TArray<FItemAttribute> GetPropertySets(TConstArrayView<int32> Rows) const;
+
+private:
+
+	struct FCaseSensitiveKeyFuncs : TDefaultMapKeyFuncs<FString, int32, false>
+	{
+		static bool Matches(const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+		static uint32 GetKeyHash(const FString& Key) { return FCrc::StrCrc32(*Key); }
+	};
+
+	void AddRow(const ANSICHAR* Raw, int32 RawLength);
+	int32 Intern(FString&& InString);
+
+	// Item i owns rows [ItemRowOffsets[i], ItemRowOffsets[i + 1])
+	TArray<int32> ItemRowOffsets;
+
+	TArray<int32> KeyIds;
+	TArray<int32> ValueIds;
+	TArray<EFragmentAttributeType> Types;
+	TArray<double> Numbers;
+	TArray<int64> TypeHashes;
+
+	TArray<FString> Strings;
+	TMap<FString, int32, FDefaultSetAllocator, FCaseSensitiveKeyFuncs> StringIds;
+
+	// Per string id, used by the property set pairing
+	TBitArray<> NameKeys;
+	TBitArray<> ValueKeys;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvexVolume.h"
+
+/**
+ * Bounding volume hierarchy over axis aligned boxes, split with a binned surface area heuristic.
+ * Primitives are the indices of the boxes passed to Build, invalid boxes are left out.
+ * Queries are read only and safe to run from several threads once built.
+ */
+class FRAGMENTSUNREAL_API FFragmentBVH
+{
+public:
+
+	// Safe to call off the game thread
+	void Build(TArray<FBox>&& InBoxes);
+	void Reset();
+
+	bool IsEmpty() const { return Nodes.Num() == 0; }
+	int32 NumPrimitives() const { return Boxes.Num(); }
+	const FBox& GetPrimitiveBox(int32 Primitive) const { return Boxes[Primitive]; }
+	FBox GetBounds() const { return Nodes.Num() > 0 ? Nodes[0].Bounds : FBox(ForceInit); }
+
+	// Visits every primitive whose box passes Overlaps. Subtrees whose bounds fail it are skipped.
+	void Query(TFunctionRef<bool(const FBox&)> Overlaps, TFunctionRef<void(int32 Primitive)> Visitor) const;
+
+	void QueryBox(const FBox& Box, TArray<int32>& OutPrimitives) const;
+	void QuerySphere(const FSphere& Sphere, TArray<int32>& OutPrimitives) const;
+	void QueryFrustum(const FConvexVolume& Frustum, TArray<int32>& OutPrimitives) const;
+
+	// Primitive whose box is closest to Point, INDEX_NONE when empty
+	int32 FindNearest(const FVector& Point, double* OutDistance = nullptr) const;
+
+	// Closest primitive hit by the ray, INDEX_NONE if none. Direction doesn't need to be normalized, distances are in its units.
+	// Visitor intersects the primitive itself and returns the hit distance, or a negative value on a miss.
+	// Nodes are opened nearest first and skipped once they start beyond the closest hit.
+	int32 Raycast(const FVector& Origin, const FVector& Direction, double MaxDistance, TFunctionRef<double(int32 Primitive, double ClosestDistance)> Visitor, double* OutDistance = nullptr) const;
+
+private:
+
+	struct FNode
+	{
+		FBox Bounds;
+		// Leaf: first slot in PrimitiveOrder. Inner node: index of the right child, the left one follows the node.
+		int32 Index = 0;
+		// 0 for inner nodes
+		int32 NumPrimitives = 0;
+	};
+
+	int32 BuildNode(int32 First, int32 Count, const TArray<FVector>& Centers);
+
+	TArray<FNode> Nodes;
+	TArray<FBox> Boxes;
+	// Primitives grouped per leaf
+	TArray<int32> PrimitiveOrder;
+};
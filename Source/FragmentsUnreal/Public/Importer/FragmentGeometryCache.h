@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UDynamicMesh.h"
+
+/**
+ * Triangulated geometry of a model, keyed by geometry hash and persisted to a single file.
+ * Lets a model skip triangulation on every launch after the first one.
+ *
+ * File layout: FHeader, then NumEntries FEntry, NumPositions FVector3f and NumIndices uint32.
+ * PayloadCrc covers everything after the header. A file with another magic, version, build settings or crc is ignored.
+ */
+class FRAGMENTSUNREAL_API FFragmentGeometryCache
+{
+public:
+
+	// Bump whenever the generated geometry changes, older files are then rebuilt
+	static constexpr uint32 Version = 4;
+
+	void SetFilePath(const FString& InFilePath) { FilePath = InFilePath; }
+	const FString& GetFilePath() const { return FilePath; }
+
+	// FFragmentMeshBuildSettings::GetSettingsHash of the meshes in the cache. Changing it drops them.
+	void SetSettingsHash(uint32 InSettingsHash);
+
+	// Reads the whole file at once. Safe to call off the game thread.
+	bool Load();
+	// Writes the file if meshes were added since it was loaded
+	bool Save();
+	void Reset();
+
+	// Thread safe
+	bool Find(uint64 GeometryHash, FDynamicMesh3& OutMesh) const;
+	void Add(uint64 GeometryHash, const FDynamicMesh3& Mesh);
+	int32 Num() const;
+
+private:
+
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 SettingsHash;
+		uint32 NumEntries;
+		uint32 NumPositions;
+		uint32 NumIndices;
+		uint32 PayloadCrc;
+	};
+
+	struct FEntry
+	{
+		uint64 GeometryHash;
+		uint32 FirstPosition;
+		uint32 NumPositions;
+		uint32 FirstIndex;
+		uint32 NumIndices;
+	};
+
+	FString FilePath;
+	uint32 SettingsHash = 0;
+
+	TArray<FEntry> Entries;
+	TArray<FVector3f> Positions;
+	TArray<uint32> Indices;
+
+	// GeometryHash -> slot in Entries
+	TMap<uint64, int32> EntryByHash;
+
+	bool bDirty = false;
+	mutable FCriticalSection Mutex;
+};
@@ -6,6 +6,11 @@
 #include "UObject/NoExportTypes.h"
 #include "Index/index_generated.h"
 #include "Utils/FragmentsUtils.h"
+#include "Importer/FragmentAttributeTable.h"
+#include "Importer/FragmentRelationIndex.h"
+#include "Importer/FragmentGeometryCache.h"
+#include "Importer/FragmentBVH.h"
+#include "Async/MappedFileHandle.h"
 #include "FragmentModelWrapper.generated.h"
 
 /**
@@ -24,11 +29,54 @@ private:
 
 	const Model* ParsedModel = nullptr;
 
-	FFragmentItem ModelItem;
+	// Set when the model is read straight from an uncompressed .frag through a memory mapping.
+	// The region must be released before the handle, so keep them in this order.
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	// Item tree stored contiguously. Slot 0 is the model root and parents always come before their children.
+	TArray<FFragmentItem> Items;
+
+	// LocalId -> slot in Items
+	TMap<int32, int32> LocalIdToItem;
+
+	// LocalId -> index into the per-item vectors of the model (local_ids, attributes, categories, guids)
+	TMap<int32, int32> LocalIdToIndex;
+
+	FFragmentAttributeTable AttributeTable;
+	FFragmentRelationIndex RelationIndex;
+
+	// Category -> LocalIds in model order. FString keys compare case-insensitively, like the old scan did.
+	TMap<FString, TArray<int32>> CategoryIndex;
+
+	// Sample bounds in model space, before the base coordinates offset, see BuildSpatialIndex
+	FFragmentBVH SpatialIndex;
+	// (item slot, sample index) of every SpatialIndex primitive
+	TArray<FIntPoint> SpatialSamples;
+	// Sample to model space, per SpatialIndex primitive
+	TArray<FTransform> SpatialTransforms;
+	// Base coordinates offset of the items, from SpatialIndex space to model space
+	FVector SpatialOffset = FVector::ZeroVector;
+
+	// Meshes built for RaycastFragments by geometry hash, released with the model
+	TMap<uint64, FDynamicMesh3> PickingMeshes;
+	int32 PickingMeshVertices = 0;
+
+	// Triangulated geometry persisted between launches, empty path when disabled
+	FFragmentGeometryCache GeometryCache;
+
+	// Settings the model geometry is built with, fixed when the model is loaded
+	FFragmentMeshBuildSettings MeshBuildSettings;
+
+	// Spawned with EFragmentSpawnMode::DataOnly, items have no actor unless requested
+	bool bDataOnly = false;
 
 	UPROPERTY()
 	class AFragment* SpawnedFragment;
 
+	// Slot of the item SpawnedFragment was spawned for, the model root unless a single item was processed
+	int32 SpawnedItemSlot = 0;
+
 	UPROPERTY()
 	TMap<int32, class UMaterialInstanceDynamic*> MaterialsMap;
 
@@ -36,16 +84,96 @@ private:
 public:
 	void LoadModel(const TArray<uint8>& InBuffer)
 	{
-		RawBuffer = InBuffer;
+		LoadModel(TArray<uint8>(InBuffer));
+	}
+
+	// Takes ownership of an already decompressed buffer without copying it.
+	void LoadModel(TArray<uint8>&& InBuffer)
+	{
+		ReleaseMapping();
+		RawBuffer = MoveTemp(InBuffer);
 		ParsedModel = GetModel(RawBuffer.GetData());
+		BuildModelIndices();
 	}
 
-	const Model* GetParsedModel() { return ParsedModel; }
+	// Maps an uncompressed .frag file and parses the model in place. Returns false if the platform can't map it.
+	bool LoadMappedModel(const FString& FragPath);
+
+	const uint8* GetBufferData() const { return MappedRegion ? MappedRegion->GetMappedPtr() : RawBuffer.GetData(); }
+	int64 GetBufferSize() const { return MappedRegion ? MappedRegion->GetMappedSize() : RawBuffer.Num(); }
+	bool IsMapped() const { return MappedRegion.IsValid(); }
+
+	const Model* GetParsedModel() const { return ParsedModel; }
+
+	int32 GetIndexForLocalId(int32 LocalId) const
+	{
+		const int32* Found = LocalIdToIndex.Find(LocalId);
+		return Found ? *Found : INDEX_NONE;
+	}
 
-	void SetModelItem(FFragmentItem InModelItem) { ModelItem = InModelItem; }
-	FFragmentItem GetModelItem() { return ModelItem; }
-	void SetSpawnedFragment(class AFragment* InSpawnedFragment) { SpawnedFragment = InSpawnedFragment; }
+	const FFragmentAttributeTable& GetAttributeTable() const { return AttributeTable; }
+	const FFragmentRelationIndex& GetRelationIndex() const { return RelationIndex; }
+	const TArray<int32>* FindLocalIdsByCategory(const FString& Category) const { return CategoryIndex.Find(Category); }
+	void GetCategories(TArray<FString>& OutCategories) const { CategoryIndex.GenerateKeyArray(OutCategories); }
+
+	// Transforms the representation box of every sample into model space and builds the BVH over them.
+	// Safe on the loading thread, the base coordinates offset applied when the model is registered goes to SetSpatialOffset.
+	void BuildSpatialIndex();
+	void SetSpatialOffset(const FVector& InOffset) { SpatialOffset = InOffset; }
+	const FVector& GetSpatialOffset() const { return SpatialOffset; }
+	const FFragmentBVH& GetSpatialIndex() const { return SpatialIndex; }
+	const FIntPoint& GetSpatialSample(int32 Primitive) const { return SpatialSamples[Primitive]; }
+	const FTransform& GetSpatialTransform(int32 Primitive) const { return SpatialTransforms[Primitive]; }
+	// LocalIds of the items owning Primitives, each one once and in the order first met
+	void GetSpatialLocalIds(TConstArrayView<int32> Primitives, TArray<int32>& OutLocalIds) const;
+
+	const FDynamicMesh3* FindPickingMesh(uint64 GeometryHash) const { return PickingMeshes.Find(GeometryHash); }
+	// Starts over once the meshes hold more than MaxPickingMeshVertices, pointers returned before are then invalid
+	const FDynamicMesh3* AddPickingMesh(uint64 GeometryHash, FDynamicMesh3&& Mesh);
+
+	const FFragmentGeometryCache& GetGeometryCache() const { return GeometryCache; }
+	FFragmentGeometryCache& GetGeometryCache() { return GeometryCache; }
+
+	void SetMeshBuildSettings(const FFragmentMeshBuildSettings& InSettings) { MeshBuildSettings = InSettings; }
+	const FFragmentMeshBuildSettings& GetMeshBuildSettings() const { return MeshBuildSettings; }
+
+	void SetItems(TArray<FFragmentItem>&& InItems);
+	const TArray<FFragmentItem>& GetItems() const { return Items; }
+	TArray<FFragmentItem>& GetItems() { return Items; }
+	const FFragmentItem& GetModelItem() const { check(Items.Num() > 0); return Items[0]; }
+
+	int32 FindItemSlot(int32 LocalId) const
+	{
+		const int32* Found = LocalIdToItem.Find(LocalId);
+		return Found ? *Found : INDEX_NONE;
+	}
+	FFragmentItem* FindItem(int32 LocalId)
+	{
+		const int32 Slot = FindItemSlot(LocalId);
+		return Slot != INDEX_NONE ? &Items[Slot] : nullptr;
+	}
+
+	void SetSpawnedFragment(class AFragment* InSpawnedFragment, int32 InItemSlot = 0) { SpawnedFragment = InSpawnedFragment; SpawnedItemSlot = InItemSlot; }
 	class AFragment* GetSpawnedFragment() { return SpawnedFragment; }
-	TMap<int32, class UMaterialInstanceDynamic*> GetMaterialsMap() { return MaterialsMap; }
+	int32 GetSpawnedItemSlot() const { return SpawnedItemSlot; }
+	// Transform of an item relative to the actor the model root is spawned under, composed along its parents
+	FTransform GetItemToModel(int32 Slot) const;
+	// True for AncestorSlot itself and every item below it
+	bool IsItemInSubtree(int32 Slot, int32 AncestorSlot) const;
+	TMap<int32, class UMaterialInstanceDynamic*>& GetMaterialsMap() { return MaterialsMap; }
+
+	void SetDataOnly(bool bInDataOnly) { bDataOnly = bInDataOnly; }
+	bool IsDataOnly() const { return bDataOnly; }
+
+private:
+
+	// Lookup tables derived from the parsed model, built once per load
+	void BuildModelIndices();
+
+	void ReleaseMapping()
+	{
+		MappedRegion.Reset();
+		MappedHandle.Reset();
+	}
 
 };
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Index/index_generated.h"
+
+/**
+ * Relations of a model parsed once into an adjacency list.
+ * Edges are grouped by source LocalId and keep the order they have in Model::relations().
+ */
+class FRAGMENTSUNREAL_API FFragmentRelationIndex
+{
+public:
+
+	// Parses Model::relations(). Safe to call off the game thread.
+	void Build(const Model* InModel);
+	void Reset();
+
+	// Id of a relation name such as IsDefinedBy or HasProperties, INDEX_NONE if the model doesn't use it
+	int32 FindRelationType(const FString& RelationName) const;
+	const FString& GetRelationName(int32 RelationType) const { return RelationNames[RelationType]; }
+	int32 NumRelationTypes() const { return RelationNames.Num(); }
+
+	// Edges leaving LocalId
+	int32 GetFirstEdge(int32 LocalId) const;
+	int32 GetNumEdges(int32 LocalId) const;
+	int32 GetEdgeType(int32 Edge) const { return EdgeTypes[Edge]; }
+	int32 GetEdgeTarget(int32 Edge) const { return EdgeTargets[Edge]; }
+
+	// Visits the targets of LocalId reached through any of RelationTypes, in model order
+	void ForEachRelated(int32 LocalId, TConstArrayView<int32> RelationTypes, TFunctionRef<void(int32 RelationType, int32 TargetLocalId)> Visitor) const;
+	void GetRelated(int32 LocalId, TConstArrayView<int32> RelationTypes, TArray<int32>& OutLocalIds) const;
+	void GetRelated(int32 LocalId, const FString& RelationName, TArray<int32>& OutLocalIds) const;
+
+private:
+
+	TArray<FString> RelationNames;
+	TMap<FString, int32> RelationTypeIds;
+
+	// LocalId -> source slot, slot s owns edges [EdgeOffsets[s], EdgeOffsets[s + 1])
+	TMap<int32, int32> SourceSlots;
+	TArray<int32> EdgeOffsets;
+	TArray<int32> EdgeTypes;
+	TArray<int32> EdgeTargets;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct TESStesselator;
+class FMemStackBase;
+
+/**
+ * Triangulates shell profiles. Triangles, convex and simple concave profiles are handled directly,
+ * only profiles with holes or self-intersections go through libtess2.
+ * The tesselator is created on first use and reused for every profile, its memory comes from an arena
+ * released with the triangulator. Not thread safe, use one per thread.
+ */
+class FRAGMENTSUNREAL_API FFragmentTriangulator
+{
+public:
+
+	FFragmentTriangulator();
+	~FFragmentTriangulator();
+
+	FFragmentTriangulator(const FFragmentTriangulator&) = delete;
+	FFragmentTriangulator& operator=(const FFragmentTriangulator&) = delete;
+
+	// Appends the triangles of Profile minus Holes, OutIndices point into OutVertices.
+	// OutSourcePoints receives the index in Points of every appended vertex, INDEX_NONE for vertices created by libtess2.
+	bool Triangulate(const TArray<FVector>& Points,
+		const TArray<int32>& Profile,
+		const TArray<TArray<int32>>& Holes,
+		TArray<FVector>& OutVertices,
+		TArray<int32>& OutIndices,
+		TArray<int32>* OutSourcePoints = nullptr);
+
+private:
+
+	bool TriangulateWithTess(const TArray<FVector>& Points,
+		const TArray<int32>& Profile,
+		const TArray<TArray<int32>>& Holes,
+		TArray<FVector>& OutVertices,
+		TArray<int32>& OutIndices,
+		TArray<int32>* OutSourcePoints);
+
+	TESStesselator* GetTesselator();
+	void ReleaseTesselator();
+
+	static void* ArenaAlloc(void* UserData, unsigned int Size);
+	static void* ArenaRealloc(void* UserData, void* Ptr, unsigned int Size);
+	static void ArenaFree(void* UserData, void* Ptr);
+
+	TESStesselator* Tess = nullptr;
+	TUniquePtr<FMemStackBase> Arena;
+
+	// Reused between profiles
+	TArray<FVector2D> Projected;
+	TArray<int32> Polygon;
+};
+
+/**
+ * Spatial hash merging vertices closer than a tolerance.
+ */
+class FRAGMENTSUNREAL_API FFragmentVertexWelder
+{
+public:
+
+	explicit FFragmentVertexWelder(double InTolerance);
+
+	// Id of a vertex added within tolerance of Position, INDEX_NONE if there is none
+	int32 Find(const FVector& Position) const;
+	void Add(const FVector& Position, int32 Id);
+
+private:
+
+	FIntVector GetCell(const FVector& Position) const;
+
+	double Tolerance;
+	TArray<FVector> Positions;
+	TArray<int32> Ids;
+	TMap<FIntVector, TArray<int32, TInlineAllocator<1>>> Cells;
+};
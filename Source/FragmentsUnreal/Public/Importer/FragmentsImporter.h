@@ -8,12 +8,123 @@
 #include "Utils/FragmentsUtils.h"
 #include "Importer/DeferredPackageSaveManager.h"
 #include "UDynamicMesh.h"
+#include "MeshDescription.h"
 #include "Materials/MaterialInstanceConstant.h"
+#include "UObject/StrongObjectPtr.h"
+#include "Importer/FragmentModelWrapper.h"
+#include <atomic>
 
 #include "FragmentsImporter.generated.h"
 
 
 FRAGMENTSUNREAL_API DECLARE_LOG_CATEGORY_EXTERN(LogFragments, Log, All);
+
+class AFragment;
+struct FConvexVolume;
+struct FMinimalViewInfo;
+
+/**
+ * State shared between the game thread and the worker running an asynchronous LoadFragment.
+ */
+struct FRAGMENTSUNREAL_API FFragmentLoadRequest : public TSharedFromThis<FFragmentLoadRequest>
+{
+	int32 RequestId = INDEX_NONE;
+	TFunction<void(int32, float)> OnProgress;
+
+	void Cancel() { bCancelled = true; }
+	bool IsCancelled() const { return bCancelled; }
+
+	// Called from the worker, forwards to OnProgress on the game thread
+	void SetProgress(float InProgress);
+
+private:
+	std::atomic<bool> bCancelled { false };
+	float LastReportedProgress = 0.0f;
+};
+
+/**
+ * A lower detail version of a static mesh, used below ScreenSize.
+ */
+struct FFragmentMeshLod
+{
+	FMeshDescription MeshDescription;
+	float ScreenSize = 0.0f;
+};
+
+/**
+ * A unique representation mesh generated before spawning. Geometry is built off the game thread, the asset on it.
+ */
+struct FFragmentRepresentationMeshJob
+{
+	const Representation* RepresentationRef = nullptr;
+	int32 MaterialIndex = INDEX_NONE;
+	uint64 GeometryHash = 0;
+	// Geometry and material key of static meshes, see UFragmentsUtils::HashGeometryWithMaterial
+	uint64 CacheKey = 0;
+	FString MeshName;
+	FMeshDescription MeshDescription;
+	// LOD1 onwards, static meshes only
+	TArray<FFragmentMeshLod> Lods;
+	FDynamicMesh3 DynamicMesh;
+	bool bBuilt = false;
+};
+
+/**
+ * Instanced components created while spawning a model in EFragmentSpawnMode::Instanced, keyed by (RepresentationIndex, MaterialIndex * 2 + bCollision).
+ * With a material palette MaterialIndex is replaced by 1 for glass and 0 for opaque samples.
+ */
+struct FFragmentInstancingContext
+{
+	TWeakObjectPtr<AFragment> Root;
+	TMap<FIntPoint, TWeakObjectPtr<class UFragmentInstancedMeshComponent>> Components;
+};
+
+/**
+ * A component whose collision is turned on by the importer's collision ticker once its physics data is cooked.
+ */
+struct FFragmentPendingCollision
+{
+	TWeakObjectPtr<class UPrimitiveComponent> Component;
+	// Cooking starts on a later frame, once the component had a chance to render
+	uint64 SpawnFrame = 0;
+};
+
+/**
+ * A loaded model being spawned over several frames by the importer's spawn ticker.
+ */
+struct FFragmentSpawnTask
+{
+	int32 TaskId = INDEX_NONE;
+	FString ModelGuid;
+	// The parsed model lives in the wrapper, keeps it alive while the workers read it even if the model is unloaded
+	TStrongObjectPtr<UFragmentModelWrapper> Wrapper;
+	int32 RootItemIndex = 0;
+	TWeakObjectPtr<AActor> Owner;
+	bool bSaveMeshes = false;
+	bool bUseDynamicMesh = false;
+	EFragmentSpawnMode SpawnMode = EFragmentSpawnMode::Actors;
+	FFragmentMeshBuildSettings BuildSettings;
+	bool bCancelled = false;
+	FFragmentInstancingContext Instancing;
+
+	TArray<FFragmentRepresentationMeshJob> MeshJobs;
+	int32 NextMeshJob = 0;
+	bool bMeshesGenerated = false;
+
+	// Breadth first, so a parent is always spawned before its children. Items are slots in the wrapper's item array.
+	TArray<TPair<int32, TWeakObjectPtr<AActor>>> PendingItems;
+	int32 NextPendingItem = 0;
+	int32 TotalItems = 0;
+	TWeakObjectPtr<AFragment> RootFragment;
+
+	// DataOnly: items below the root with their transform relative to it
+	TArray<TPair<int32, FTransform>> PendingInstances;
+	int32 NextPendingInstance = 0;
+
+	TFunction<void(int32, float)> OnProgress;
+	TFunction<void(int32, AFragment*)> OnCompleted;
+};
+
 /**
  * 
  */
@@ -25,8 +136,10 @@ class FRAGMENTSUNREAL_API UFragmentsImporter :public UObject
 public:
 
 	UFragmentsImporter();
+	virtual void BeginDestroy() override;
 
-	FString Process(AActor* OwnerA, const FString& FragPath, TArray<AFragment*>& OutFragments, bool bSaveMeshes = true, bool bUseDynamicMesh = false);
+	// A preset other than Custom overrides the mesh build settings for this model only
+	FString Process(AActor* OwnerA, const FString& FragPath, TArray<AFragment*>& OutFragments, bool bSaveMeshes = true, bool bUseDynamicMesh = false, EFragmentSpawnMode SpawnMode = EFragmentSpawnMode::Actors, EFragmentMeshBuildPreset BuildPreset = EFragmentMeshBuildPreset::Custom);
 	void SetOwnerRef(AActor* NewOwnerRef) { OwnerRef = NewOwnerRef; }
 	
 	[[deprecated("Use as parameter FFragmentItem instead.")]]
@@ -36,15 +149,46 @@ public:
 	TArray<FItemAttribute> GetItemPropertySets(AFragment* InFragment);
 	TArray<FItemAttribute> GetItemPropertySets(FFragmentItem* InFragment);
 	TArray<FItemAttribute> GetItemPropertySets(int32 LocalId, const FString& InModelGuid);
+	TArray<int32> GetRelatedItems(int32 LocalId, const FString& InModelGuid, const FString& RelationName);
 	AFragment* GetItemByLocalId(int32 LocalId, const FString& ModelGuid);
 	FFragmentItem* GetFragmentItemByLocalId(int32 LocalId, const FString& InModelGuid);
 	FString LoadFragment(const FString& FragPath);
-	void ProcessLoadedFragment(const FString& ModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh);
-	void ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh);
+	int32 LoadFragmentAsync(const FString& FragPath, TFunction<void(int32, float)> OnProgress, TFunction<void(int32, const FString&)> OnCompleted);
+	void CancelLoadFragment(int32 RequestId);
+	void ProcessLoadedFragment(const FString& ModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode = EFragmentSpawnMode::Actors);
+	void ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode = EFragmentSpawnMode::Actors);
+	// Spawns the model over several frames, spending at most SpawnBudgetMs per frame
+	int32 ProcessLoadedFragmentAsync(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, TFunction<void(int32, float)> OnProgress, TFunction<void(int32, AFragment*)> OnCompleted);
+	void CancelProcessLoadedFragment(int32 TaskId);
+	void SetSpawnBudgetMs(float InBudgetMs) { SpawnBudgetMs = FMath::Max(InBudgetMs, 0.1f); }
+	float GetSpawnBudgetMs() const { return SpawnBudgetMs; }
+	// Triangulated geometry is cached in this directory, or next to the .frag when empty
+	void SetGeometryCacheDirectory(const FString& InDirectory) { GeometryCacheDirectory = InDirectory; }
+	const FString& GetGeometryCacheDirectory() const { return GeometryCacheDirectory; }
+	void SetUseGeometryCache(bool bInUseGeometryCache) { bUseGeometryCache = bInUseGeometryCache; }
+	bool GetUseGeometryCache() const { return bUseGeometryCache; }
+	// Applies to models loaded after the call, so every model can use its own
+	void SetMeshBuildSettings(const FFragmentMeshBuildSettings& InSettings) { MeshBuildSettings = InSettings; }
+	const FFragmentMeshBuildSettings& GetMeshBuildSettings() const { return MeshBuildSettings; }
 	TArray<int32> GetElementsByCategory(const FString& InCategory, const FString& ModelGuid);
+	TArray<int32> GetElementsByCategories(const TArray<FString>& InCategories, const FString& ModelGuid);
+	TArray<FFragmentCategoryElements> GetElementsByCategoriesGrouped(const TArray<FString>& InCategories, const FString& ModelGuid);
+	TArray<FString> GetCategories(const FString& ModelGuid);
+	// Spatial queries in world space over the bounds of every sample, see UFragmentModelWrapper::BuildSpatialIndex
+	TArray<int32> GetElementsInBox(const FBox& Box, const FString& ModelGuid);
+	TArray<int32> GetElementsInSphere(const FVector& Center, float Radius, const FString& ModelGuid);
+	TArray<int32> GetElementsInFrustum(const FConvexVolume& Frustum, const FString& ModelGuid);
+	TArray<int32> GetElementsInFrustum(const FMinimalViewInfo& View, const FString& ModelGuid);
+	// Item whose bounds are closest to Point, INDEX_NONE for an empty or unknown model
+	int32 GetNearestElement(const FVector& Point, const FString& ModelGuid);
+	// Closest triangle hit in any spawned model, without collision. MaxDistance and OutHit.Distance are in cm.
+	bool RaycastFragments(const FVector& Origin, const FVector& Direction, float MaxDistance, FFragmentRaycastHit& OutHit);
 	void UnloadFragment(const FString& ModelGuid);
 	AFragment* GetModelFragment(const FString& ModelGuid);
 	FTransform GetBaseCoordinates() { return BaseCoordinates; }
+	// Components hidden while waiting for collision leave the queue, showing them again puts them back.
+	// False if the component wasn't waiting for collision.
+	static bool ResumeComponentCollision(class UPrimitiveComponent* InComponent);
 
 	FORCEINLINE const TMap<FString, class UFragmentModelWrapper*>& GetFragmentModels() const
 	{
@@ -53,15 +197,57 @@ public:
 
 private:
 
-	void CollectPropertiesRecursive(const Model* InModel, int32 StartLocalId, TSet<int32>& Visited, TArray<FItemAttribute>& OutAttributes);
+	static bool BuildModelData(const FString& FragPath, class UFragmentModelWrapper* Wrapper, FFragmentLoadRequest* Request);
+	static bool LoadModelBuffer(const FString& FragPath, class UFragmentModelWrapper* Wrapper, FFragmentLoadRequest* Request = nullptr);
+	static bool ReadFragmentFile(const FString& FragPath, TArray<uint8>& OutBuffer, FFragmentLoadRequest* Request = nullptr);
+	FString GetGeometryCachePath(const FString& FragPath) const;
+	// Settings of a loaded model, the importer's current ones otherwise
+	const FFragmentMeshBuildSettings& GetModelMeshBuildSettings(const FString& ModelGuid) const;
+	static void FillItemData(const class UFragmentModelWrapper* Wrapper, FFragmentItem* InFragmentItem);
+	FString RegisterLoadedModel(class UFragmentModelWrapper* Wrapper);
+	// From the spatial index of a model to the world, following the actor it was spawned as. Only the base coordinates offset until it is spawned.
+	FTransform GetModelToWorld(class UFragmentModelWrapper* Wrapper) const;
+	// Triangles of a sample for picking: spawned dynamic meshes are reused, others are read from the geometry cache or built once
+	const FDynamicMesh3* FindOrBuildPickingMesh(class UFragmentModelWrapper* Wrapper, const FFragmentSample& Sample);
+	void CollectPropertiesRecursive(const class UFragmentModelWrapper* Wrapper, int32 StartLocalId, TSet<int32>& Visited, TArray<int32>& OutRows);
 	void SpawnStaticMesh(UStaticMesh* StaticMesh, const Transform* LocalTransform, const Transform* GlobalTransform, AActor* Owner, FName OptionalTag = FName());
 	void SpawnFragmentModel(AFragment* InFragmentModel, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes);
-	AFragment* SpawnFragmentModel(FFragmentItem InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, class UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh);
+	AFragment* SpawnFragmentModel(const FFragmentItem& InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, class UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode);
+	AFragment* SpawnFragmentModel(const FFragmentItem& InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, class UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh, FFragmentInstancingContext* Instancing);
+	// Spawns the actor carrying the item data, without any mesh
+	AFragment* SpawnFragmentActor(const FFragmentItem& InFragmentItem, AActor* InParent, const FTransform& InRelativeTransform);
+	AFragment* SpawnDataOnlyItem(int32 LocalId, const FString& ModelGuid);
+	// Spawns a single item and its mesh components, without its children. With an instancing context samples become instances on the context root.
+	AFragment* SpawnFragmentItem(const FFragmentItem& InFragmentItem, AActor* InParent, const Meshes* MeshesRef, bool bSaveMeshes, class UFragmentModelWrapper* InWrapperRef, bool bUseDynamicMesh, FFragmentInstancingContext* Instancing = nullptr);
+	UStaticMesh* GetRepresentationStaticMesh(const Representation* representation, const Material* material, uint64 GeometryHash, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes);
+	void AddSampleInstance(FFragmentInstancingContext& Instancing, const FFragmentSample& Sample, const FTransform& InstanceTransform, const FFragmentItem& InFragmentItem, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes);
+	void AddItemInstances(FFragmentInstancingContext& Instancing, const FFragmentItem& InFragmentItem, const FTransform& ItemToInstancingRoot, const Meshes* MeshesRef, bool bSaveMeshes);
+	void FlushSampleInstances(FFragmentInstancingContext& Instancing);
+	bool TickSpawnTasks(float DeltaTime);
+	// A model is spawned by one task at a time, a second spawn would build and name the same assets
+	bool IsSpawnTaskRunning(const FString& ModelGuid) const;
+	// Applies the collision policy of the model, call before the component is registered
+	void SetupComponentCollision(class UPrimitiveComponent* InComponent, const FString& Category, const FFragmentMeshBuildSettings& Settings);
+	void QueueComponentCollision(class UPrimitiveComponent* InComponent);
+	bool TickCollisionCooking(float DeltaTime);
+	// Hidden components taken out of the collision queue, with the importer that queued them
+	static TMap<TWeakObjectPtr<class UPrimitiveComponent>, TWeakObjectPtr<UFragmentsImporter>>& HiddenPendingCollision();
+	void OnCollisionCooked(bool bSuccess, TWeakObjectPtr<class UBodySetup> BodySetup);
+	void FinishSpawnTask(const TSharedPtr<FFragmentSpawnTask>& Task);
+	// Builds every representation used by the item tree up front: geometry is generated in parallel, assets are created on the game thread
+	void BuildRepresentationMeshes(class UFragmentModelWrapper* Wrapper, int32 RootItemIndex, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes, bool bUseDynamicMesh);
+	// With a TaskId, static meshes already being built by an earlier spawn task are left to it
+	void CollectRepresentationMeshJobs(const class UFragmentModelWrapper* Wrapper, int32 RootItemIndex, const Meshes* MeshesRef, const FString& InModelGuid, bool bUseDynamicMesh, TArray<FFragmentRepresentationMeshJob>& OutJobs, int32 TaskId = INDEX_NONE);
+	// Dynamic meshes generated here are also added to GeometryCache and written to disk
+	static void GenerateRepresentationMeshes(TArray<FFragmentRepresentationMeshJob>& Jobs, const Meshes* MeshesRef, bool bUseDynamicMesh, const FFragmentMeshBuildSettings& Settings, class FFragmentGeometryCache* GeometryCache);
+	void FinalizeRepresentationMesh(FFragmentRepresentationMeshJob& Job, const Meshes* MeshesRef, const FString& InModelGuid, bool bSaveMeshes, bool bUseDynamicMesh);
+	void SaveMeshPackage(UStaticMesh* Mesh, UPackage* MeshPackage, const FString& MeshName, const FString& PackageFileName);
 	UStaticMesh* CreateStaticMeshFromShell(
 		const Shell* ShellRef,
 		const Material* RefMaterial,
 		const FString& AssetName,
-		UObject* OuterRef, const FString& InModelGuid
+		UObject* OuterRef, const FString& InModelGuid,
+		const FBox& Bounds
 	);
 	UStaticMesh* CreateStaticMeshFromCircleExtrusion(
 		const CircleExtrusion* CircleExtrusion,
@@ -69,33 +255,39 @@ private:
 		const FString& AssetName,
 		UObject* OuterRef, const FString& InModelGuid
 	);
-	FDynamicMesh3 CreateDynamicMeshFromShell(
-		const Shell* ShellRef,
+	UStaticMesh* CreateStaticMeshFromDescription(
+		FMeshDescription& MeshDescription,
 		const Material* RefMaterial,
 		const FString& AssetName,
-		UObject* OuterRef
-	);
-	FDynamicMesh3 CreateDynamicMeshFromCircleExtrusion(
-		const CircleExtrusion* CircleExtrusion,
-		const Material* RefMaterial,
-		const FString& AssetName,
-		UObject* OuterRef
+		UObject* OuterRef, const FString& InModelGuid,
+		RepresentationClass InRepresentationClass,
+		TArray<FFragmentMeshLod>* Lods = nullptr
 	);
 
+	// Geometry builders below don't touch UObjects and are safe to run off the game thread
+	static void BuildShellMeshDescription(const Shell* ShellRef, const FString& AssetName, FMeshDescription& MeshDescription, const FFragmentMeshBuildSettings& Settings);
+	static FDynamicMesh3 CreateDynamicMeshFromShell(const Shell* ShellRef, const FFragmentMeshBuildSettings& Settings);
+	// Splits the normals of a welded mesh only across edges sharper than Settings.HardEdgeAngle
+	static void ApplyHardEdgeNormals(FDynamicMesh3& DynamicMesh, const FFragmentMeshBuildSettings& Settings);
+	static FDynamicMesh3 CreateDynamicMeshFromCircleExtrusion(const CircleExtrusion* CircleExtrusion, const FFragmentMeshBuildSettings& Settings);
+	static void BuildCircleExtrusionLods(const CircleExtrusion* CircleExtrusion, const FFragmentMeshBuildSettings& Settings, TArray<FFragmentMeshLod>& OutLods);
+	// Bounds is the representation box, the mesh bounds are used when it is invalid
+	static void BuildShellLods(const FMeshDescription& MeshDescription, const FBox& Bounds, const FFragmentMeshBuildSettings& Settings, TArray<FFragmentMeshLod>& OutLods);
+	static void BuildBoxMeshDescription(const FBox& Box, FMeshDescription& MeshDescription, const FFragmentMeshBuildSettings& Settings);
+	// Vertex normals, and tangents if enabled, of a generated description. The render data is built from them as they are.
+	static void ComputeDescriptionNormals(FMeshDescription& MeshDescription, const FFragmentMeshBuildSettings& Settings);
+
 	FName AddMaterialToMesh(UStaticMesh*& CreatedMesh, const Material* RefMaterial, const FString& InModelGuid);
+	UMaterialInterface* GetOrCreateMaterial(const Material* RefMaterial, const FString& InModelGuid, UObject* InOuter);
 	void AddMaterialToDynamicMesh(class UDynamicMeshComponent* InDynComp, const Material* RefMaterial, UFragmentModelWrapper* InWrapperRef, int32 InMaterialIndex);
+	// Material palette: assigns the shared opaque or glass material and passes the color through custom primitive data 0-3
+	void ApplyPaletteMaterial(class UPrimitiveComponent* InComponent, const Material* RefMaterial);
 
-	bool TriangulatePolygonWithHoles(const TArray<FVector>& Points,
-		const TArray<int32>& Profiles,
-		const TArray<TArray<int32>>& Holes,
-		TArray<FVector>& OutVertices,
-		TArray<int32>& OutIndices);
-
-	void BuildFullCircleExtrusion(UStaticMeshDescription& StaticMeshDescription, const CircleExtrusion* CircleExtrusion, const Material* RefMaterial, UStaticMesh* StaticMesh, const FString& InModelGuid);
+	static void BuildFullCircleExtrusion(FMeshDescription& MeshDescription, const CircleExtrusion* CircleExtrusion, const FFragmentMeshBuildSettings& Settings);
 
 	void BuildLineOnlyMesh(UStaticMeshDescription& StaticMeshDescription, const CircleExtrusion* CircleExtrusion);
 
-	TArray<FVector> SampleRingPoints(const FVector& Center, const FVector XDir, const FVector& YDir, float Radius, int SegmentCount, float ApertureRadians);
+	static TArray<FVector> SampleRingPoints(const FVector& Center, const FVector XDir, const FVector& YDir, float Radius, int SegmentCount, float ApertureRadians);
 
 	void SavePackagesWithProgress(const TArray<UPackage*>& InPackagesToSave);
 
@@ -121,8 +313,12 @@ private:
 	UPROPERTY()
 	TMap<FString, UStaticMesh*> MeshCache;
 
-	TMap<uint32, UStaticMesh*>   StaticMeshByRepId;  
-	TMap<uint32, FDynamicMesh3>  DynamicMeshByRepId;
+	// Geometry shared by every model of the session, keyed by content hash (plus material for static meshes)
+	UPROPERTY()
+	TMap<uint64, UStaticMesh*> StaticMeshByGeometryHash;
+	TMap<uint64, FDynamicMesh3> DynamicMeshByGeometryHash;
+	// Static meshes whose geometry is being generated for a spawn task, keyed like StaticMeshByGeometryHash, valued by task id
+	TMap<uint64, int32> InFlightStaticMeshes;
 
 	UPROPERTY()
 	TMap<FString, UMaterialInstanceConstant*> MaterialsCache;
@@ -141,6 +337,24 @@ private:
 
 	FDeferredPackageSaveManager DeferredSaveManager;
 
+	TMap<int32, TSharedPtr<FFragmentLoadRequest>> LoadRequests;
+	int32 LastLoadRequestId = 0;
+
+	TArray<TSharedPtr<FFragmentSpawnTask>> SpawnTasks;
+	int32 LastSpawnTaskId = 0;
+	FTSTicker::FDelegateHandle SpawnTickerHandle;
+	float SpawnBudgetMs = 5.0f;
+
+	TArray<FFragmentPendingCollision> PendingCollision;
+	// Body setups cooking on worker threads, true once done. Static mesh ones are shared by every component of the mesh.
+	TMap<TWeakObjectPtr<class UBodySetup>, bool> CookingBodySetups;
+	FTSTicker::FDelegateHandle CollisionTickerHandle;
+
+	FString GeometryCacheDirectory;
+	bool bUseGeometryCache = true;
+
+	FFragmentMeshBuildSettings MeshBuildSettings;
+
 public:
 
 	TArray<class AFragment*> FragmentActors;
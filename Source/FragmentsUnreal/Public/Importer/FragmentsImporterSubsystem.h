@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "Utils/FragmentsUtils.h"
+#include "Importer/FragmentsImporter.h"
+#include "Camera/CameraTypes.h"
 #include "FragmentsImporterSubsystem.generated.h"
 
 struct FComponentSavedState
@@ -29,26 +31,89 @@ public:
 	UFUNCTION(BlueprintCallable)
 	FString LoadFragment(const FString& FragPath);
 	
+	// Loads the model on a worker thread. Only the final model registration runs on the game thread.
+	UFUNCTION(BlueprintCallable)
+	int32 LoadFragmentAsync(const FString& FragPath, FOnFragmentLoadProgress OnProgress, FOnFragmentLoadCompleted OnCompleted);
+
+	UFUNCTION(BlueprintCallable)
+	void CancelLoadFragment(int32 RequestId);
+
 	UFUNCTION(BlueprintCallable)
 	void UnloadFragment(const FString& ModelGuid);
 
+	// BuildPreset overrides the mesh build settings for this model, Custom keeps the ones from SetMeshBuildSettings
+	UFUNCTION(BlueprintCallable)
+	FString ProcessFragment(AActor* OwnerActor, const FString& FragPath, TArray<class AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode = EFragmentSpawnMode::Actors, EFragmentMeshBuildPreset BuildPreset = EFragmentMeshBuildPreset::Custom);
+
+	UFUNCTION(BlueprintCallable)
+	void ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode = EFragmentSpawnMode::Actors);
+
+	UFUNCTION(BlueprintCallable)
+	void ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode = EFragmentSpawnMode::Actors);
+
+	// Spawns the model over several frames without exceeding the spawn budget per frame.
+	UFUNCTION(BlueprintCallable)
+	int32 ProcessLoadedFragmentAsync(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh, EFragmentSpawnMode SpawnMode, FOnFragmentSpawnProgress OnProgress, FOnFragmentSpawnCompleted OnCompleted);
+
+	UFUNCTION(BlueprintCallable)
+	void CancelProcessLoadedFragment(int32 TaskId);
+
 	UFUNCTION(BlueprintCallable)
-	FString ProcessFragment(AActor* OwnerActor, const FString& FragPath, TArray<class AFragment*>& OutFragments, bool bSaveMeshes, bool bUseDynamicMesh);
+	void SetSpawnBudgetMs(float InBudgetMs);
 
+	// Directory of the triangulated geometry cache files, next to each .frag when empty
 	UFUNCTION(BlueprintCallable)
-	void ProcessLoadedFragment(const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh);
+	void SetGeometryCacheDirectory(const FString& InDirectory);
 
 	UFUNCTION(BlueprintCallable)
-	void ProcessLoadedFragmentItem(int32 InLocalId, const FString& InModelGuid, AActor* InOwnerRef, bool bInSaveMesh, bool bUseDynamicMesh);
+	void SetUseGeometryCache(bool bInUseGeometryCache);
+
+	// Welding, LODs and tessellation of the models loaded from now on
+	UFUNCTION(BlueprintCallable)
+	void SetMeshBuildSettings(const FFragmentMeshBuildSettings& InSettings);
 
 	UFUNCTION(BlueprintCallable)
 	TArray<int32> GetElementsByCategory(const FString& InCategory, const FString& ModelGuid);
 
+	// Union of the elements of all InCategories
+	UFUNCTION(BlueprintCallable)
+	TArray<int32> GetElementsByCategories(const TArray<FString>& InCategories, const FString& ModelGuid);
+
+	// One entry per requested category, in the same order
+	UFUNCTION(BlueprintCallable)
+	TArray<FFragmentCategoryElements> GetElementsByCategoriesGrouped(const TArray<FString>& InCategories, const FString& ModelGuid);
+
+	UFUNCTION(BlueprintCallable)
+	TArray<FString> GetCategories(const FString& ModelGuid);
+
+	// Elements whose bounds overlap the world space box
+	UFUNCTION(BlueprintCallable)
+	TArray<int32> GetElementsInBox(const FBox& Box, const FString& ModelGuid);
+
+	UFUNCTION(BlueprintCallable)
+	TArray<int32> GetElementsInSphere(const FVector& Center, float Radius, const FString& ModelGuid);
+
+	// Elements whose bounds are at least partly visible from View, e.g. the camera's GetCameraView
+	UFUNCTION(BlueprintCallable)
+	TArray<int32> GetElementsInFrustum(const FMinimalViewInfo& View, const FString& ModelGuid);
+
+	// Element whose bounds are closest to Point, INDEX_NONE if there is none
+	UFUNCTION(BlueprintCallable)
+	int32 GetNearestElement(const FVector& Point, const FString& ModelGuid);
+
+	// Picks the closest element of any loaded model along the ray against its triangles. Works with collision disabled.
+	UFUNCTION(BlueprintCallable)
+	bool RaycastFragments(const FVector& Origin, const FVector& Direction, FFragmentRaycastHit& OutHit, float MaxDistance = 1000000.0f);
+
 	UFUNCTION(BlueprintCallable)
 	AFragment* GetItemByLocalId(int32 InLocalId, const FString& InModelGuid);
 
 	UFUNCTION(BlueprintCallable)
 	TArray<FItemAttribute> GetItemPropertySets(int32 LocalId, const FString& InModelGuid);
+
+	// LocalIds related to LocalId through RelationName, e.g. IsDefinedBy or ContainsElements
+	UFUNCTION(BlueprintCallable)
+	TArray<int32> GetRelatedItems(int32 LocalId, const FString& InModelGuid, const FString& RelationName);
 	
 	FFragmentItem* GetFragmentItemByLocalId(int32 InLocalId, const FString& InModelGuid);
 	void GetItemData(FFragmentItem* InFragmentItem);
@@ -170,6 +235,9 @@ private:
         {
             if (!IsValid(C)) continue;
 
+            // Items hidden before their collision was cooked get it from the importer once cooked
+            const bool bCollisionPending = UFragmentsImporter::ResumeComponentCollision(C);
+
             if (FComponentSavedState* Saved = Cache().Find(C))
             {
                 C->SetHiddenInGame(Saved->bHiddenInGame);
@@ -183,7 +251,7 @@ private:
             {
                 // Best-effort if it was spawned after we hid: make it usable.
                 C->SetHiddenInGame(false);
-                C->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+                if (!bCollisionPending) C->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
                 C->SetGenerateOverlapEvents(true);
                 C->SetComponentTickEnabled(C->PrimaryComponentTick.bCanEverTick);
             }
@@ -127,6 +127,9 @@ struct FFragmentSample
 	int32 RepresentationIndex = -1;
 	UPROPERTY()
 	int32 MaterialIndex = -1;
+	// Content hash of the representation's geometry, see UFragmentsUtils::HashRepresentationGeometry
+	UPROPERTY()
+	uint64 GeometryHash = 0;
 };
 
 
@@ -152,6 +155,40 @@ struct FItemAttribute
 		:Key(InKey), Value(InValue), PropertySet(InPropertySet), TypeHash(InTypeHash) {}
 };
 
+USTRUCT(BlueprintType)
+struct FFragmentCategoryElements
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FString Category;
+
+	UPROPERTY(BlueprintReadOnly)
+	TArray<int32> LocalIds;
+};
+
+USTRUCT(BlueprintType)
+struct FFragmentRaycastHit
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FString ModelGuid;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 LocalId = INDEX_NONE;
+
+	UPROPERTY(BlueprintReadOnly)
+	FVector Location = FVector::ZeroVector;
+
+	// Face normal, turned towards the ray origin
+	UPROPERTY(BlueprintReadOnly)
+	FVector Normal = FVector::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly)
+	float Distance = 0.0f;
+};
+
 USTRUCT()
 struct FFragmentItem
 {
@@ -159,37 +196,148 @@ struct FFragmentItem
 	GENERATED_BODY()
 
 	FString ModelGuid;
-	int32 LocalId;
+	int32 LocalId = INDEX_NONE;
 	FString Category;
 	FString Guid;
 	TArray<FItemAttribute> Attributes;  // List of attributes for the fragment
-	TArray <FFragmentItem*> FragmentChildren;  // Use TObjectPtr for nested recursion
+	int32 ParentIndex = INDEX_NONE;  // Slot of the parent in UFragmentModelWrapper::GetItems()
+	TArray<int32> ChildIndices;  // Slots of the children in UFragmentModelWrapper::GetItems()
 	TArray<FFragmentSample> Samples;
 	FTransform GlobalTransform;
+};
 
-	bool FindFragmentByLocalId(int32 InLocalId, FFragmentItem*& OutItem)
-	{
-		// Check if the current item matches the LocalId
-		if (LocalId == InLocalId)
-		{
-			OutItem = this;
-			return true;
-		}
+UENUM(BlueprintType)
+enum class EFragmentSpawnMode : uint8
+{
+	// One mesh component per sample on each item actor
+	Actors,
+	// Samples sharing a representation and material are drawn by a single instanced component on the root actor
+	Instanced,
+	// Like Instanced, but only the root is an actor. Other items stay as data in the model wrapper
+	DataOnly
+};
 
-		// If not, search through all children recursively
-		for (FFragmentItem* Child : FragmentChildren)
-		{
-			if (Child->FindFragmentByLocalId(InLocalId, OutItem))
-			{
-				return true;
-			}
-		}
+UENUM(BlueprintType)
+enum class EFragmentCollisionMode : uint8
+{
+	// Nothing is cooked, use UFragmentsImporter::RaycastFragments for picking
+	None,
+	// One box around the representation. Openings and steps are filled, meant for slab-like categories only.
+	BoundingBox,
+	// Convex hull of the representation vertices
+	SimpleConvex,
+	// The render triangles are used for queries and physics
+	ComplexAsSimple
+};
 
-		// If no match is found, return nullptr
-		return false;
-	}
+UENUM(BlueprintType)
+enum class EFragmentMeshBuildPreset : uint8
+{
+	// Keep the settings as they are
+	Custom,
+	// Quickest import to look at a model: no LODs, tangents, lightmap UVs or reversed index buffer
+	Preview,
+	// Dynamic lighting such as Lumen: no lightmap UVs or reversed index buffer
+	Lumen,
+	// Baked lighting: lightmap UVs, reversed index buffer and weighted normals
+	Production
+};
+
+/**
+ * Options used when representation geometry is generated.
+ */
+USTRUCT(BlueprintType)
+struct FFragmentMeshBuildSettings
+{
+	GENERATED_BODY()
+
+	// Merge coincident shell vertices instead of duplicating them per profile. Normals are only split across hard edges.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bWeldShellVertices = true;
+
+	// Vertices closer than this, in cm, are merged
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float WeldTolerance = 0.01f;
+
+	// Faces meeting at a larger angle, in degrees, don't share normals
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float HardEdgeAngle = 30.0f;
+
+	// Static meshes get lower detail LODs: fewer ring segments for circle extrusions, a bounding box for shells
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bGenerateLods = true;
+
+	// Screen size below which circle extrusions use reduced rings
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float ReducedLodScreenSize = 0.1f;
+
+	// Screen size below which representations use their cheapest proxy
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float ProxyLodScreenSize = 0.03f;
+
+	// Largest distance, in cm, between a circle extrusion and its tessellation
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float ChordTolerance = 0.1f;
+
+	// Ring segments of the thinnest circle extrusions
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 MinCircleSegments = 6;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 MaxCircleSegments = 48;
+
+	// Every mesh uses one of two shared materials, opaque or glass, and gets its RGBA through custom primitive data 0-3
+	// (per instance custom data when instanced). Not exposed until the shipped base materials read their color from there.
+	bool bUseMaterialPalette = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EFragmentCollisionMode CollisionMode = EFragmentCollisionMode::None;
+
+	// Only items of these categories get collision, e.g. IFCSLAB, IFCSTAIRFLIGHT, IFCWALLSTANDARDCASE. Empty for every item.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FString> CollisionCategories;
+
+	// Components spawn without collision and get it once their physics data is cooked on worker threads,
+	// starting the frame after they are first rendered. Otherwise collision is cooked while spawning.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bCookCollisionAsync = true;
+
+	// Shells get a lightmap UV channel, only needed for baked lighting
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bGenerateLightmapUVs = false;
+
+	// Index buffer for negatively scaled instances, only needed when they exist
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bBuildReversedIndexBuffer = false;
+
+	// Flat colored materials don't need tangents
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bComputeTangents = true;
+
+	// Static mesh vertex normals are weighted by face area and angle, also when saved assets are rebuilt from their source model
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bComputeWeightedNormals = false;
+
+	// Overrides the options covered by Preset, the other ones are kept
+	void ApplyPreset(EFragmentMeshBuildPreset Preset);
+
+	// Whether items of Category get collision
+	bool WantsCollision(const FString& Category) const;
+
+	// Segments of a full ring of Radius, in cm, within ChordTolerance
+	int32 GetCircleSegmentCount(double Radius) const;
+	// Divisions of an arc of Radius, in cm, within ChordTolerance
+	int32 GetArcDivisionCount(double Radius, double ApertureRadians) const;
+
+	// Changes whenever a setting affecting the generated geometry changes
+	uint32 GetSettingsHash() const;
 };
 
+DECLARE_DYNAMIC_DELEGATE_TwoParams(FOnFragmentLoadProgress, int32, RequestId, float, Progress);
+DECLARE_DYNAMIC_DELEGATE_ThreeParams(FOnFragmentLoadCompleted, int32, RequestId, bool, bSuccess, const FString&, ModelGuid);
+DECLARE_DYNAMIC_DELEGATE_TwoParams(FOnFragmentSpawnProgress, int32, TaskId, float, Progress);
+DECLARE_DYNAMIC_DELEGATE_ThreeParams(FOnFragmentSpawnCompleted, int32, TaskId, bool, bSuccess, AFragment*, RootFragment);
+
 /**
  * 
  */
@@ -202,20 +350,31 @@ public:
 
 	//UFUNCTION(BlueprintCallable, Category = "Fragments")
 	static FTransform MakeTransform(const Transform* FragmentsTransform, bool bIsLocalTransform = false);
+	// Fragments bounding box in Unreal axes and units, invalid if the box is empty
+	static FBox MakeBox(const BoundingBox& FragmentsBox);
+	// Material RGBA as a linear color, channels in [0, 1]
+	static FLinearColor MakeColor(const Material* MaterialRef);
 	static FPlaneProjection BuildProjectionPlane(const TArray<FVector>& Points, const TArray<int32>& Profile);
 	static bool IsClockwise(const TArray<FVector2D>& Points);
+	// Parses on every call, loaded models keep the parsed attributes in UFragmentModelWrapper::GetAttributeTable
 	static TArray<FItemAttribute> ParseItemAttribute(const Attribute* Attr);
 	static class AFragment* MapModelStructure(const SpatialStructure* InS, AFragment*& ParentActor, TMap<int32, AFragment*>& FragmentLookupMapRef, const FString& InheritedCategory);
-	static void MapModelStructureToData(const SpatialStructure* InS, FFragmentItem& ParentItem, const FString& InheritedCategory);
+	static void MapModelStructureToData(const SpatialStructure* InS, TArray<FFragmentItem>& Items, int32 ParentIndex, const FString& InheritedCategory);
 	static FString GetIfcCategory(const int64 InTypeHash);
 	static float SafeComponent(float Value);
 	static FVector SafeVector(const FVector& Vec);
 	static FRotator SafeRotator(const FRotator& Rot);
+	// Linear scan, loaded models should use UFragmentModelWrapper::GetIndexForLocalId instead
 	static int32 GetIndexForLocalId(const Model* InModelRef, int32 LocalId);
 	static TArray<FItemAttribute> ParsePropertySets(const TArray<FItemAttribute>& InAttributes);
+	static bool IsValueKey(const FString& Key);
+
+	// Hash of the shell or circle extrusion payload and the build settings hash, equal for identical geometry in any model
+	static uint64 HashRepresentationGeometry(const Meshes* MeshesRef, const Representation* RepresentationRef, uint32 SettingsHash);
+	// With a material palette only the opaque or glass base material is baked in the mesh, not the color
+	static uint64 HashGeometryWithMaterial(uint64 GeometryHash, const Material* MaterialRef, const FFragmentMeshBuildSettings& Settings);
 
 private:
-	static bool IsValueKey(const FString& Key);
 	//void MapSpatialStructureRecursive(const SpatialStructure* Node, int32 ParentId, TArray<FSpatialStructure>& OutList);
 
 };